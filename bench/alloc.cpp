@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Counts the allocations made when filling result sets and splitting filter
+ * lists, comparing the former approach (a std::string for every field) with
+ * arena-backed sets and string views.
+ */
+#include "../src/arena.hpp"
+#include "../src/util.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+#define BENCH_ROWS 20000
+#define BENCH_LIST_SZ 2000
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+	++allocations;
+	if(void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+struct string_row {
+	int id;
+	std::string name, description;
+};
+
+struct view_row {
+	int id;
+	std::string_view name, description;
+};
+
+// split as it was before, copying and erasing from the front of its input
+static std::vector<std::string> old_split(std::string str, const std::string &delim) {
+	std::vector<std::string> result;
+	size_t pos = 0;
+
+	while((pos = str.find(delim)) not_eq std::string::npos) {
+		result.push_back(str.substr(0, pos));
+		str.erase(0, pos + delim.size());
+	}
+	result.push_back(str);
+
+	return result;
+}
+
+template<typename F>
+static void report(const std::string &name, F f) {
+	const size_t before = allocations;
+
+	f();
+	std::cout << name << ": " << allocations - before << " allocations" << std::endl;
+}
+
+int main(void) {
+	sqlite3 *db;
+	std::string list, populate;
+	const char *query = "SELECT id, name, description FROM recipes";
+
+	if(sqlite3_open(":memory:", &db) not_eq SQLITE_OK)
+		return EXIT_FAILURE;
+	populate = "CREATE TABLE recipes(id INTEGER PRIMARY KEY, name TEXT, description TEXT);"
+		"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < "
+		+ std::to_string(BENCH_ROWS) + ") "
+		"INSERT INTO recipes SELECT i, 'Some rather long recipe name ' || i, "
+		"'A description that does not fit in a short string ' || i FROM n;";
+	sqlite3_exec(db, populate.c_str(), nullptr, nullptr, nullptr);
+
+	report("std::vector<string_row>", [&]() {
+		std::vector<string_row> rows;
+		sqlite3_exec(db, query, [](void *rows, int, char **col_data, char**) {
+			static_cast<std::vector<string_row>*>(rows)->push_back({
+				std::atoi(col_data[0]), col_data[1], col_data[2] });
+			return 0;
+		}, &rows, nullptr);
+	});
+	report("result_set<view_row>", [&]() {
+		result_set<view_row> rows;
+		sqlite3_exec(db, query, [](void *rows, int, char **col_data, char**) {
+			result_set<view_row> *set = static_cast<result_set<view_row>*>(rows);
+			set->push_back({ std::atoi(col_data[0]), set->store(col_data[1]),
+						   set->store(col_data[2]) });
+			return 0;
+		}, &rows, nullptr);
+	});
+	sqlite3_close(db);
+
+	for(int i = 0; i < BENCH_LIST_SZ; ++i)
+		list += (i ? ", " : "") + std::string("ingredient number ") + std::to_string(i);
+
+	report("split + trim", [&]() {
+		std::vector<std::string> items = old_split(list, ",");
+		for(auto &i : items)
+			trim(i);
+	});
+	report("split_list", [&]() {
+		const std::vector<std::string> items = split_list(list);
+	});
+	report("split_view + trim_view", [&]() {
+		std::vector<std::string_view> items = split_view(list, ",");
+		for(auto &i : items)
+			i = trim_view(i);
+	});
+
+	return EXIT_SUCCESS;
+}
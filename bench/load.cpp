@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Load generator for the database layer: N reader threads run list and info
+ * queries while M writer threads add and delete recipes and ingredients on
+ * the same database, each thread with a connection of its own, as separate
+ * menu-helper processes would have.
+ *
+ * usage: load [-r readers] [-w writers] [-t seconds] [-R rate] [-m mix] [-o file] <db>
+ *
+ *   -r, -w  Number of reader and writer threads (default 4 and 1).
+ *   -t      Duration of the run in seconds (default 10).
+ *   -R      Operations per second of every thread; 0 (the default) runs
+ *           them back to back.
+ *   -m      Weights of the operations, e.g. "list:1,info:9,add:2,add-ingr:2,del:1"
+ *           (the default). Readers pick among list and info, writers among
+ *           add, add-ingr and del.
+ *   -o      Write the results as JSON to a file.
+ *
+ * Latencies are kept in log-linear (HDR-style) histograms: exact below 64
+ * microseconds, and with 32 buckets per power of two above. With a rate they
+ * are measured from the time an operation was due, so that stalls count
+ * against every operation they delayed.
+ */
+#include "../src/db.hpp"
+#include "../src/util.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB + (64 - HIST_SUB_BITS) * HIST_SUB / 2)
+
+enum op {
+	OP_LIST,
+	OP_INFO,
+	OP_ADD,
+	OP_ADD_INGR,
+	OP_DEL,
+	OP_NUM
+};
+
+static const char *op_names[OP_NUM] = { "list", "info", "add", "add-ingr", "del" };
+
+/*
+ * Quote a string for JSON output.
+ */
+static std::string json_string(const std::string_view str) {
+	std::string quoted = "\"";
+
+	for(const char c : str) {
+		if(c == '"' or c == '\\')
+			quoted += std::format("\\{}", c);
+		else if(static_cast<unsigned char>(c) < ' ')
+			quoted += std::format("\\u{:04x}", static_cast<int>(c));
+		else
+			quoted += c;
+	}
+
+	return quoted + "\"";
+}
+
+class histogram {
+private:
+	std::vector<uint64_t> counts;
+	uint64_t total, max;
+
+	static size_t bucket_of(const uint64_t value) {
+		if(value < HIST_SUB)
+			return value;
+		const int shift = std::bit_width(value) - HIST_SUB_BITS;
+		return HIST_SUB + (shift - 1) * (HIST_SUB / 2) + ((value >> shift) - HIST_SUB / 2);
+	}
+
+	// highest value that falls in a bucket
+	static uint64_t bucket_top(const size_t bucket) {
+		if(bucket < HIST_SUB)
+			return bucket;
+		const int shift = (bucket - HIST_SUB) / (HIST_SUB / 2) + 1;
+		const uint64_t mantissa = (bucket - HIST_SUB) % (HIST_SUB / 2) + HIST_SUB / 2;
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+public:
+	histogram() : counts(HIST_BUCKETS), total(0), max(0) {}
+
+	void record(const uint64_t value) {
+		++counts[bucket_of(value)];
+		++total;
+		max = std::max(max, value);
+	}
+
+	void merge(const histogram &other) {
+		for(size_t i = 0; i < counts.size(); ++i)
+			counts[i] += other.counts[i];
+		total += other.total;
+		max = std::max(max, other.max);
+	}
+
+	uint64_t percentile(const double p) const {
+		const uint64_t rank = std::max<uint64_t>(1, std::ceil(p / 100 * total));
+		uint64_t seen = 0;
+
+		for(size_t i = 0; i < counts.size(); ++i) {
+			if((seen += counts[i]) >= rank)
+				return std::min(bucket_top(i), max);
+		}
+
+		return max;
+	}
+
+	uint64_t count(void) const { return total; }
+	uint64_t get_max(void) const { return max; }
+};
+
+struct op_stats {
+	histogram latency;
+	uint64_t busy = 0, errors = 0;
+};
+
+struct load_config {
+	std::string path;
+	int readers = 4, writers = 1;
+	int seconds = 10;
+	double rate = 0;
+	double mix[OP_NUM] = { 1, 9, 2, 2, 1 };
+};
+
+// returns false if there was nothing to do, e.g. no recipe left to delete
+static bool run_op(db &db, const enum op op, const int thread, std::mt19937 &rng,
+				   const std::vector<int> &ids, std::vector<int> &own, int &added) {
+	switch(op) {
+	case OP_LIST:
+		db.get_recipes({}, {});
+		break;
+	case OP_INFO: {
+		const int id = ids.empty() ? 1 : ids[rng() % ids.size()];
+		db.get_recipe(id);
+		db.get_recipe_ingredient_amounts(id);
+		db.get_recipe_tags(id);
+		break;
+	}
+	case OP_ADD:
+		own.push_back(db.add_recipe(std::format("load test {} {}", thread, added++), "load test"));
+		break;
+	case OP_ADD_INGR: {
+		const int ingr_id = db.add_ingredient(std::format("load ingredient {}", rng() % 100));
+		if(not own.empty())
+			db.conn_recipe_ingredient(own[rng() % own.size()], ingr_id);
+		break;
+	}
+	case OP_DEL:
+		if(own.empty())
+			return false;
+		db.del_recipe(own.back());
+		own.pop_back();
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+/*
+ * Opening checks the version of the database, which fails as well while a
+ * writer holds the lock, so keep trying until the end of the run.
+ */
+static void reopen(db &db, const std::string &path, const std::chrono::steady_clock::time_point deadline) {
+	db.close();
+	while(true) {
+		try {
+			db.open(path);
+			return;
+		} catch(const std::runtime_error&) {
+			db.close();
+			if(std::chrono::steady_clock::now() >= deadline)
+				throw;
+		}
+	}
+}
+
+static void worker(const struct load_config &config, const int thread, const bool writer,
+				   const std::vector<int> &ids, const std::chrono::steady_clock::time_point deadline,
+				   std::vector<struct op_stats> &stats) {
+	const enum op first = writer ? OP_ADD : OP_LIST;
+	const enum op last = writer ? OP_DEL : OP_INFO;
+	const auto interval = std::chrono::nanoseconds(config.rate > 0 ? static_cast<int64_t>(1e9 / config.rate) : 0);
+	std::discrete_distribution<int> pick(config.mix + first, config.mix + last + 1);
+	std::mt19937 rng(thread);
+	std::vector<int> own;
+	int added = 0;
+	db db;
+
+	reopen(db, config.path, deadline);
+
+	auto due = std::chrono::steady_clock::now();
+	while(due < deadline) {
+		const enum op op = static_cast<enum op>(first + pick(rng));
+
+		if(interval.count())
+			std::this_thread::sleep_until(due);
+		else
+			due = std::chrono::steady_clock::now();
+
+		try {
+			if(run_op(db, op, thread, rng, ids, own, added)) {
+				stats[op].latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::steady_clock::now() - due).count());
+			}
+		} catch(const std::runtime_error&) {
+			const int code = db.get_error_code() & 0xff;
+
+			if(code == SQLITE_BUSY or code == SQLITE_LOCKED)
+				++stats[op].busy;
+			else
+				++stats[op].errors;
+			// don't leave a failed operation's transaction open
+			reopen(db, config.path, deadline);
+		}
+
+		due += interval;
+	}
+
+	// leave the database as it was
+	for(const auto id : own) {
+		try {
+			db.del_recipe(id);
+		} catch(const std::runtime_error&) {}
+	}
+	db.close();
+}
+
+static bool parse_mix(const std::string &mix, double weights[OP_NUM]) {
+	std::fill(weights, weights + OP_NUM, 0);
+
+	for(const auto &item : split_list(mix)) {
+		const std::vector<std::string_view> pair = split_view(item, ":");
+		int op = 0;
+
+		while(op < OP_NUM and pair[0] not_eq op_names[op])
+			++op;
+		if(op == OP_NUM or pair.size() not_eq 2)
+			return false;
+		weights[op] = std::stod(std::string(pair[1]));
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	struct load_config config;
+	std::vector<std::vector<struct op_stats>> stats;
+	std::vector<std::thread> threads;
+	std::vector<int> ids;
+	std::string json_path;
+	int opt;
+
+	while((opt = getopt(argc, argv, "r:w:t:R:m:o:")) not_eq -1) {
+		switch(opt) {
+		case 'r':
+			config.readers = std::stoi(optarg);
+			break;
+		case 'w':
+			config.writers = std::stoi(optarg);
+			break;
+		case 't':
+			config.seconds = std::stoi(optarg);
+			break;
+		case 'R':
+			config.rate = std::stod(optarg);
+			break;
+		case 'm':
+			if(not parse_mix(optarg, config.mix)) {
+				std::cerr << "Invalid operation mix '" << optarg << "'." << std::endl;
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'o':
+			json_path = optarg;
+			break;
+		default:
+			std::cerr << "usage: " << argv[0]
+				<< " [-r readers] [-w writers] [-t seconds] [-R rate] [-m mix] [-o file] <db>" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if(optind not_eq argc - 1) {
+		std::cerr << "No database given." << std::endl;
+		return EXIT_FAILURE;
+	}
+	config.path = argv[optind];
+
+	if((config.readers and config.mix[OP_LIST] + config.mix[OP_INFO] <= 0) or
+	   (config.writers and config.mix[OP_ADD] + config.mix[OP_ADD_INGR] + config.mix[OP_DEL] <= 0)) {
+		std::cerr << "The operation mix leaves readers or writers nothing to do." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		db db;
+		db.open(config.path);
+		for(const auto &recipe : db.get_recipes({}, {}))
+			ids.push_back(recipe.id);
+		db.close();
+	} catch(const std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	stats.resize(config.readers + config.writers, std::vector<struct op_stats>(OP_NUM));
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.seconds);
+	for(int i = 0; i < config.readers + config.writers; ++i) {
+		threads.emplace_back([&, i]() {
+			try {
+				worker(config, i, i >= config.readers, ids, deadline, stats[i]);
+			} catch(const std::runtime_error &e) {
+				std::cerr << e.what() << std::endl;
+			}
+		});
+	}
+	for(auto &thread : threads)
+		thread.join();
+
+	std::string json = std::format("{{\"db\":{},\"readers\":{},\"writers\":{},\"seconds\":{},\"rate\":{:g},\"operations\":{{",
+								   json_string(config.path), config.readers, config.writers, config.seconds, config.rate);
+	std::cout << std::format("{:<10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}{:>8}{:>8}\n",
+							 "OP", "COUNT", "OPS/S", "P50(us)", "P99(us)", "P999(us)", "MAX(us)", "BUSY", "ERRORS");
+	bool first = true;
+	for(int op = 0; op < OP_NUM; ++op) {
+		struct op_stats total;
+
+		for(const auto &thread_stats : stats) {
+			total.latency.merge(thread_stats[op].latency);
+			total.busy += thread_stats[op].busy;
+			total.errors += thread_stats[op].errors;
+		}
+		if(total.latency.count() + total.busy + total.errors == 0)
+			continue;
+
+		const double throughput = static_cast<double>(total.latency.count()) / config.seconds;
+		std::cout << std::format("{:<10}{:>10}{:>10.1f}{:>10}{:>10}{:>10}{:>10}{:>8}{:>8}\n",
+								 op_names[op], total.latency.count(), throughput,
+								 total.latency.percentile(50), total.latency.percentile(99),
+								 total.latency.percentile(99.9), total.latency.get_max(),
+								 total.busy, total.errors);
+		json += std::format("{}\"{}\":{{\"count\":{},\"throughput\":{:.1f},\"p50_us\":{},\"p99_us\":{},"
+							"\"p999_us\":{},\"max_us\":{},\"busy\":{},\"errors\":{}}}",
+							first ? "" : ",", op_names[op], total.latency.count(), throughput,
+							total.latency.percentile(50), total.latency.percentile(99),
+							total.latency.percentile(99.9), total.latency.get_max(),
+							total.busy, total.errors);
+		first = false;
+	}
+	json += "}}\n";
+
+	if(not json_path.empty()) {
+		std::ofstream out(json_path);
+		if(not (out << json)) {
+			std::cerr << "Failed to write " << json_path << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
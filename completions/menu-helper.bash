@@ -0,0 +1,80 @@
+# bash completion for menu-helper                          -*- shell-script -*-
+#
+# Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+_menu_helper_names()
+{
+	# complete the last element of a comma-separated list
+	local kind=$1 cur=$2 head="" name
+	if [[ $cur == *,* ]]; then
+		head=${cur%,*},
+		cur=${cur##*,}
+	fi
+
+	local IFS=$'\n'
+	for name in $(menu-helper complete "$kind" "$cur" 2>/dev/null); do
+		[[ $kind == id ]] && name=${name%%$'\t'*}
+		COMPREPLY+=("$(printf '%q' "$head$name")")
+	done
+}
+
+_menu_helper()
+{
+	local cur=${COMP_WORDS[COMP_CWORD]} prev=${COMP_WORDS[COMP_CWORD-1]}
+	local cmd=${COMP_WORDS[1]} arg=0 i
+	COMPREPLY=()
+
+	if [[ $COMP_CWORD -eq 1 ]]; then
+		COMPREPLY=($(compgen -W "add new del rm list ls info i suggest cooked
+			shopping-list shop nutrition set-nutrition similar dedupe complete
+			edit-name edit-description edit-desc add-ingr rm-ingr add-tag rm-tag
+			merge-ingr merge-tag move-tag tags rename-ingr add-sub rm-sub subs attach
+			attachment ingest backup export sync stats browse help version" -- "$cur"))
+		return
+	fi
+
+	case $prev in
+		-i) _menu_helper_names ingredient "$cur"; return ;;
+		-t) _menu_helper_names tag "$cur"; return ;;
+		-d|--db) COMPREPLY=($(compgen -f -- "$cur")); return ;;
+		-n|-s|--max-kcal) return ;;
+	esac
+
+	# index of the current word among the positional arguments
+	for ((i = 2; i < COMP_CWORD; ++i)); do
+		case ${COMP_WORDS[i]} in
+			-i|-t|-n|-s|-d|--db|--max-kcal) ((++i)) ;;
+			-*) ;;
+			*) ((++arg)) ;;
+		esac
+	done
+
+	case $cmd in
+		del|rm|info|i|edit-name|edit-description|edit-desc|cooked|similar|shopping-list|shop|nutrition)
+			_menu_helper_names id "$cur" ;;
+		add-ingr|rm-ingr)
+			[[ $arg -eq 0 ]] && _menu_helper_names id "$cur" || _menu_helper_names ingredient "$cur" ;;
+		add-tag|rm-tag)
+			[[ $arg -eq 0 ]] && _menu_helper_names id "$cur" || _menu_helper_names tag "$cur" ;;
+		attach)
+			[[ $arg -eq 0 ]] && _menu_helper_names id "$cur" || COMPREPLY=($(compgen -f -- "$cur")) ;;
+		attachment)
+			[[ $arg -eq 0 ]] && _menu_helper_names id "$cur" ;;
+		merge-ingr|rename-ingr|add-sub|rm-sub|subs|set-nutrition)
+			[[ $arg -le 1 ]] && _menu_helper_names ingredient "$cur" ;;
+		merge-tag|move-tag)
+			_menu_helper_names tag "$cur" ;;
+		backup|sync)
+			COMPREPLY=($(compgen -f -- "$cur")) ;;
+		ingest)
+			[[ $arg -eq 0 ]] && COMPREPLY=($(compgen -d -- "$cur")) ;;
+		complete)
+			[[ $arg -eq 0 ]] && COMPREPLY=($(compgen -W "ingredient tag recipe id" -- "$cur")) ;;
+	esac
+} &&
+	complete -F _menu_helper menu-helper
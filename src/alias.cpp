@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "alias.hpp"
+
+#include <numeric>
+
+alias_table::alias_table(const std::vector<double> &weights) :
+	prob(weights.size()), alias(weights.size())
+{
+	const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+	std::vector<size_t> small, large;
+
+	for(size_t i = 0; i < weights.size(); ++i) {
+		prob[i] = weights[i] * weights.size() / total;
+		if(prob[i] < 1)
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	while(not small.empty() and not large.empty()) {
+		const size_t s = small.back(), l = large.back();
+
+		small.pop_back();
+		alias[s] = l;
+		prob[l] -= 1 - prob[s];
+		if(prob[l] < 1) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// whatever is left over is only off by rounding errors
+	for(auto i : small)
+		prob[i] = 1;
+	for(auto i : large)
+		prob[i] = 1;
+}
+
+size_t alias_table::sample(std::mt19937 &rng) const {
+	std::uniform_int_distribution<size_t> column(0, prob.size() - 1);
+	std::uniform_real_distribution<double> coin(0, 1);
+	const size_t i = column(rng);
+
+	return coin(rng) < prob[i] ? i : alias[i];
+}
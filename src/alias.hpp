@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Walker's alias method: after an O(n) setup, draws an index in
+ * [0, n) with probability proportional to its weight in O(1).
+ */
+class alias_table {
+private:
+	std::vector<double> prob;
+	std::vector<size_t> alias;
+
+public:
+	/**
+	 * @param weights Non-negative weights, at least one of them positive.
+	 */
+	explicit alias_table(const std::vector<double> &weights);
+
+	size_t sample(std::mt19937 &rng) const;
+	inline size_t size(void) const {
+		return prob.size();
+	}
+};
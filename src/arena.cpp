@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+std::string_view arena::copy(const std::string_view str) {
+	char *dest;
+
+	// nothing to copy, and a fresh arena has nowhere to copy it to
+	if(str.empty())
+		return std::string_view();
+
+	if(str.size() > left) {
+		// strings too long for a block get one of their own
+		const size_t size = std::max<size_t>(str.size(), ARENA_BLOCK_SZ);
+
+		blocks.push_back(std::make_unique_for_overwrite<char[]>(size));
+		next = blocks.back().get();
+		left = size;
+	}
+
+	dest = next;
+	std::memcpy(dest, str.data(), str.size());
+	next += str.size();
+	left -= str.size();
+
+	return std::string_view(dest, str.size());
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// size of the blocks strings are copied into
+#define ARENA_BLOCK_SZ 65536
+
+/**
+ * @brief A bump allocator for strings. Copies are appended to large blocks,
+ * which are only freed, all at once, along with the arena.
+ */
+class arena {
+private:
+	std::vector<std::unique_ptr<char[]>> blocks;
+	// room left in the last block
+	char *next;
+	size_t left;
+
+public:
+	arena() : next(nullptr), left(0) {}
+	// a moved-from arena must not keep pointing into the blocks it gave away
+	arena(arena &&other) :
+		blocks(std::move(other.blocks)),
+		next(std::exchange(other.next, nullptr)),
+		left(std::exchange(other.left, 0)) {}
+	arena &operator=(arena &&other) {
+		blocks = std::move(other.blocks);
+		next = std::exchange(other.next, nullptr);
+		left = std::exchange(other.left, 0);
+		return *this;
+	}
+
+	/**
+	 * @brief Copy a string into the arena.
+	 *
+	 * @return A view of the copy, valid as long as the arena.
+	 */
+	std::string_view copy(const std::string_view str);
+};
+
+/**
+ * @brief Rows of a query whose strings are views into an arena owned by the
+ * set, so that filling it takes a handful of allocations rather than some
+ * for every row.
+ */
+template<typename Row>
+class result_set {
+private:
+	arena strings;
+	std::vector<Row> rows;
+
+public:
+	/**
+	 * @brief Keep a copy of a string (which may be null, as SQLite columns)
+	 * for the rows of the set.
+	 */
+	std::string_view store(const char *str) {
+		return str ? strings.copy(str) : std::string_view();
+	}
+
+	void push_back(const Row &row) {
+		rows.push_back(row);
+	}
+
+	typename std::vector<Row>::const_iterator begin(void) const { return rows.begin(); }
+	typename std::vector<Row>::const_iterator end(void) const { return rows.end(); }
+	const Row &operator[](const size_t i) const { return rows[i]; }
+	size_t size(void) const { return rows.size(); }
+	bool empty(void) const { return rows.empty(); }
+};
@@ -28,12 +28,36 @@ enum cmd_id {
 	CMD_DEL,
 	CMD_LIST,
 	CMD_INFO,
+	CMD_SUGGEST,
+	CMD_COOKED,
+	CMD_SHOPPING_LIST,
+	CMD_NUTRITION,
+	CMD_SET_NUTRITION,
 	CMD_EDIT_NAME,
 	CMD_EDIT_DESC,
 	CMD_ADD_INGR,
 	CMD_RM_INGR,
 	CMD_ADD_TAG,
 	CMD_RM_TAG,
+	CMD_MERGE_INGR,
+	CMD_MERGE_TAG,
+	CMD_MOVE_TAG,
+	CMD_TAGS,
+	CMD_RENAME_INGR,
+	CMD_ADD_SUB,
+	CMD_RM_SUB,
+	CMD_SUBS,
+	CMD_ATTACH,
+	CMD_ATTACHMENT,
+	CMD_SIMILAR,
+	CMD_DEDUPE,
+	CMD_COMPLETE,
+	CMD_INGEST,
+	CMD_BACKUP,
+	CMD_EXPORT,
+	CMD_SYNC,
+	CMD_STATS,
+	CMD_BROWSE,
 	CMD_HELP,
 	CMD_VERSION,
 };
@@ -43,12 +67,36 @@ static const std::map<enum cmd_id, std::vector<std::string>> commands = {
 	{ CMD_DEL, {"del", "rm"} },
 	{ CMD_LIST, {"list", "ls"} },
 	{ CMD_INFO, {"info", "i"} },
+	{ CMD_SUGGEST, {"suggest"} },
+	{ CMD_COOKED, {"cooked"} },
+	{ CMD_SHOPPING_LIST, {"shopping-list", "shop"} },
+	{ CMD_NUTRITION, {"nutrition"} },
+	{ CMD_SET_NUTRITION, {"set-nutrition"} },
 	{ CMD_EDIT_NAME, {"edit-name"} },
 	{ CMD_EDIT_DESC, {"edit-description", "edit-desc"} },
 	{ CMD_ADD_INGR, {"add-ingr"} },
 	{ CMD_RM_INGR, {"rm-ingr"} },
 	{ CMD_ADD_TAG, {"add-tag"} },
 	{ CMD_RM_TAG, {"rm-tag"} },
+	{ CMD_MERGE_INGR, {"merge-ingr"} },
+	{ CMD_MERGE_TAG, {"merge-tag"} },
+	{ CMD_MOVE_TAG, {"move-tag"} },
+	{ CMD_TAGS, {"tags"} },
+	{ CMD_RENAME_INGR, {"rename-ingr"} },
+	{ CMD_ADD_SUB, {"add-sub"} },
+	{ CMD_RM_SUB, {"rm-sub"} },
+	{ CMD_SUBS, {"subs"} },
+	{ CMD_ATTACH, {"attach"} },
+	{ CMD_ATTACHMENT, {"attachment"} },
+	{ CMD_SIMILAR, {"similar"} },
+	{ CMD_DEDUPE, {"dedupe"} },
+	{ CMD_COMPLETE, {"complete"} },
+	{ CMD_INGEST, {"ingest"} },
+	{ CMD_BACKUP, {"backup"} },
+	{ CMD_EXPORT, {"export"} },
+	{ CMD_SYNC, {"sync"} },
+	{ CMD_STATS, {"stats"} },
+	{ CMD_BROWSE, {"browse"} },
 	{ CMD_HELP, {"help", "-h", "--help"} },
 	{ CMD_VERSION, {"version", "-v", "--version"} },
 };
@@ -70,12 +118,36 @@ static inline void print_help(void) {
 		   "\tdel, rm                      Delete recipe by ID.\n"
 		   "\tlist, ls                     List recipes with filters.\n"
 		   "\tinfo                         Show recipe information.\n"
+		   "\tsuggest                      Pick recipes at random with filters.\n"
+		   "\tcooked                       Record that a recipe was cooked.\n"
+		   "\tshopping-list, shop          Total the ingredients of recipes.\n"
+		   "\tnutrition                    Show nutrients of recipes.\n"
+		   "\tset-nutrition                Set nutrients of an ingredient.\n"
 		   "\tedit-name                    Change recipe name.\n"
 		   "\tedit-description, edit-desc  Change recipe description.\n"
-		   "\tadd-ingr                     Add ingredient to a recipe.\n"
-		   "\trm-ingr                      Remove ingredient from a recipe.\n"
-		   "\tadd-tag                      Add tag to a recipe.\n"
-		   "\trm-tag                       Remove tag from a recipe.\n"
+		   "\tadd-ingr                     Add ingredient to recipes.\n"
+		   "\trm-ingr                      Remove ingredient from recipes.\n"
+		   "\tadd-tag                      Add tag to recipes.\n"
+		   "\trm-tag                       Remove tag from recipes.\n"
+		   "\tmerge-ingr                   Replace ingredients by another.\n"
+		   "\tmerge-tag                    Replace tags by another.\n"
+		   "\tmove-tag                     Place a tag under another.\n"
+		   "\ttags                         Show the hierarchy of tags.\n"
+		   "\trename-ingr                  Change ingredient name.\n"
+		   "\tadd-sub                      Add substitutes for an ingredient.\n"
+		   "\trm-sub                       Remove substitutes for an ingredient.\n"
+		   "\tsubs                         List substitutes for an ingredient.\n"
+		   "\tattach                       Attach a file to a recipe.\n"
+		   "\tattachment                   Write a recipe's attachment to stdout.\n"
+		   "\tsimilar                      List recipes with similar ingredients.\n"
+		   "\tdedupe                       Find (and merge) duplicate recipes.\n"
+		   "\tcomplete                     List names starting with a prefix.\n"
+		   "\tingest                       Import recipes from saved web pages.\n"
+		   "\tbackup                       Copy the database while in use.\n"
+		   "\texport                       Export recipes changed since a point.\n"
+		   "\tsync                         Reconcile with another database.\n"
+		   "\tstats                        Show statistics of the catalog.\n"
+		   "\tbrowse                       Narrow down recipes interactively.\n"
 		   "\thelp, -h, --help             Show this help information.\n"
 		   "\tversion, -v, --version       Show version information.\n"
 		   << std::endl;
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * @brief A queue between threads holding at most a fixed number of items, so
+ * that producers running ahead of the consumer block instead of piling up
+ * memory.
+ */
+template<typename T>
+class bounded_queue {
+private:
+	std::deque<T> items;
+	const size_t capacity;
+	bool closed;
+	std::mutex mutex;
+	std::condition_variable not_full, not_empty;
+
+public:
+	bounded_queue(const size_t capacity) : capacity(capacity), closed(false) {}
+
+	/**
+	 * @brief Add an item, waiting for there to be room for it.
+	 */
+	void push(T item) {
+		std::unique_lock lock(mutex);
+
+		not_full.wait(lock, [this]() { return items.size() < capacity; });
+		items.push_back(std::move(item));
+		lock.unlock();
+		not_empty.notify_one();
+	}
+
+	/**
+	 * @brief Take the oldest item, waiting for there to be one.
+	 *
+	 * @return The item, or nothing if the queue is empty and closed.
+	 */
+	std::optional<T> pop(void) {
+		std::unique_lock lock(mutex);
+
+		not_empty.wait(lock, [this]() { return not items.empty() or closed; });
+		if(items.empty())
+			return std::nullopt;
+
+		std::optional<T> item(std::move(items.front()));
+		items.pop_front();
+		lock.unlock();
+		not_full.notify_one();
+
+		return item;
+	}
+
+	/**
+	 * @brief Signal that no more items will be added.
+	 */
+	void close(void) {
+		{
+			std::lock_guard lock(mutex);
+			closed = true;
+		}
+		not_empty.notify_all();
+	}
+};
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "browser.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <format>
+#include <iterator>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#define BROWSER_ID_COL_SZ 5
+#define BROWSER_NAME_COL_SZ 24
+
+/*
+ * Cut a line to fit in a number of columns, without splitting a UTF-8
+ * character (wide characters are counted as a single column).
+ */
+static std::string_view fit(const std::string_view line, const size_t width) {
+	size_t len = 0, cols = 0;
+
+	while(len < line.size() and cols < width) {
+		++len;
+		while(len < line.size() and (line[len] & 0xc0) == 0x80)
+			++len;
+		++cols;
+	}
+
+	return line.substr(0, len);
+}
+
+static size_t columns(const std::string_view line) {
+	return std::count_if(line.begin(), line.end(), [](const char c) {
+						 return (c & 0xc0) not_eq 0x80;
+						 });
+}
+
+/*
+ * Number of elements two sorted lists have in common.
+ */
+static size_t count_common(const std::vector<int> &a, const std::vector<int> &b) {
+	size_t count = 0;
+
+	for(auto i = a.begin(), j = b.begin(); i not_eq a.end() and j not_eq b.end();) {
+		if(*i < *j) {
+			++i;
+		} else if(*j < *i) {
+			++j;
+		} else {
+			++count;
+			++i;
+			++j;
+		}
+	}
+
+	return count;
+}
+
+// nothing to do but interrupt the read of the next key, so as to redraw
+static void on_resize(int) {}
+
+browser::browser(const recipe_set &recipes,
+				 const std::map<std::string, std::vector<int>> &ingredients,
+				 const std::map<std::string, std::vector<int>> &tags) :
+	recipes(recipes), list_height(1), tty(-1)
+{
+	std::vector<int> all(recipes.size());
+
+	// the lists are turned from IDs into indices, which are sorted the same
+	for(const auto &[from, to] : { std::make_pair(&ingredients, &this->ingredients),
+								   std::make_pair(&tags, &this->tags) }) {
+		for(const auto &[name, ids] : *from) {
+			std::vector<int> &rows = (*to)[name];
+			auto recipe = recipes.begin();
+
+			for(const int id : ids) {
+				recipe = std::lower_bound(recipe, recipes.end(), id, [](const struct recipe_view &r, const int id) {
+										  return r.id < id;
+										  });
+				if(recipe == recipes.end())
+					break;
+				if(recipe->id == id)
+					rows.push_back(recipe - recipes.begin());
+			}
+		}
+	}
+
+	for(size_t i = 0; i < all.size(); ++i)
+		all[i] = i;
+	levels.push_back({ "", std::move(all), 0, 0 });
+}
+
+/*
+ * Recipes with an ingredient, or with a tag if there's no such ingredient or
+ * the term starts with '#'.
+ */
+const std::vector<int> *browser::find_term(const std::string &term) const {
+	std::string name(trim_view(term));
+
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+				   return std::tolower(c);
+				   });
+
+	if(not name.empty() and name[0] == '#') {
+		const auto tag = tags.find(name.substr(1));
+		return tag == tags.end() ? nullptr : &tag->second;
+	}
+
+	if(const auto ingredient = ingredients.find(name); ingredient not_eq ingredients.end())
+		return &ingredient->second;
+	if(const auto tag = tags.find(name); tag not_eq tags.end())
+		return &tag->second;
+
+	return nullptr;
+}
+
+void browser::add_term(void) {
+	const std::vector<int> *term_rows = find_term(input);
+	struct level level = { std::string(trim_view(input)), {}, 0, 0 };
+
+	if(not term_rows) {
+		message = std::format("No ingredient or tag '{}'.", level.term);
+		return;
+	}
+
+	const std::vector<int> &rows = levels.back().rows;
+	level.rows.reserve(std::min(rows.size(), term_rows->size()));
+	std::set_intersection(rows.begin(), rows.end(), term_rows->begin(), term_rows->end(),
+						  std::back_inserter(level.rows));
+
+	levels.push_back(std::move(level));
+	input.clear();
+}
+
+void browser::move(const long rows) {
+	struct level &level = levels.back();
+	const long last = static_cast<long>(level.rows.size()) - 1;
+
+	level.selected = std::clamp(static_cast<long>(level.selected) + rows, 0L, std::max(last, 0L));
+	if(level.selected < level.scroll)
+		level.scroll = level.selected;
+	else if(level.selected >= level.scroll + list_height)
+		level.scroll = level.selected - list_height + 1;
+}
+
+void browser::render(void) {
+	struct winsize winsize;
+	std::string out = "\x1b[H";
+	std::string terms;
+
+	if(ioctl(tty, TIOCGWINSZ, &winsize) == -1 or winsize.ws_col == 0 or winsize.ws_row == 0) {
+		winsize.ws_col = 80;
+		winsize.ws_row = 24;
+	}
+	const size_t width = winsize.ws_col;
+	// the header, status and prompt take a line each
+	list_height = std::max(1, winsize.ws_row - 3);
+	struct level &level = levels.back();
+	const std::string prompt(fit("> " + input, width));
+
+	move(0);
+
+	out += fit(std::format("{:<{}}{:<{}}{}", "ID", BROWSER_ID_COL_SZ, "NAME", BROWSER_NAME_COL_SZ, "DESCRIPTION"), width);
+	out += "\x1b[K\r\n";
+
+	// only the rows on the screen are formatted
+	for(int i = 0; i < list_height; ++i) {
+		const size_t row = level.scroll + i;
+
+		if(row < level.rows.size()) {
+			const struct recipe_view &recipe = recipes[level.rows[row]];
+			const std::string line = std::format("{:<{}}{:<{}}{}", recipe.id, BROWSER_ID_COL_SZ,
+												 fit(recipe.name, BROWSER_NAME_COL_SZ - 1), BROWSER_NAME_COL_SZ,
+												 recipe.description);
+			if(row == level.selected)
+				out += "\x1b[7m";
+			out += fit(line, width);
+			if(row == level.selected)
+				out += "\x1b[0m";
+		}
+		out += "\x1b[K\r\n";
+	}
+
+	for(size_t i = 1; i < levels.size(); ++i)
+		terms += (i > 1 ? " > " : " | ") + levels[i].term;
+	out += fit(std::format("{} of {} recipes{}{}{}", level.rows.size(), recipes.size(), terms,
+						   message.empty() ? "" : " | ", message), width);
+	out += "\x1b[K\r\n";
+
+	// how many recipes the term being typed would leave
+	out += prompt;
+	if(const std::vector<int> *term_rows = find_term(input); term_rows and not input.empty()) {
+		const std::string hint = std::format("  ({} recipes)", count_common(level.rows, *term_rows));
+		if(columns(prompt) + hint.size() <= width)
+			out += "\x1b[2m" + hint + "\x1b[0m";
+	}
+	out += std::format("\x1b[K\x1b[{};{}H", list_height + 3, std::min(width, columns(prompt) + 1));
+
+	write_all(out);
+}
+
+void browser::write_all(const std::string_view out) {
+	for(size_t written = 0; written < out.size();) {
+		const ssize_t n = write(tty, out.data() + written, out.size() - written);
+
+		if(n < 0 and errno not_eq EINTR)
+			break;
+		written += std::max<ssize_t>(n, 0);
+	}
+}
+
+int browser::run(void) {
+	struct termios raw;
+	struct sigaction resize = {}, saved_resize;
+	char keys[32];
+	int picked = -1;
+	bool done = false;
+
+	if((tty = ::open("/dev/tty", O_RDWR)) == -1)
+		throw std::runtime_error("Failed to open the terminal.");
+
+	tcgetattr(tty, &saved_termios);
+	raw = saved_termios;
+	raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+	raw.c_iflag &= ~(IXON | ICRNL);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(tty, TCSAFLUSH, &raw);
+
+	// without SA_RESTART, so that resizing interrupts reading keys
+	resize.sa_handler = on_resize;
+	sigaction(SIGWINCH, &resize, &saved_resize);
+
+	// switch to the alternate screen, as other full-screen programs do
+	write_all("\x1b[?1049h");
+
+	// give the terminal back as it was however browsing ends, exceptions included
+	struct terminal_guard {
+		browser &b;
+		const struct sigaction &saved_resize;
+
+		~terminal_guard() {
+			b.write_all("\x1b[?1049l");
+			sigaction(SIGWINCH, &saved_resize, nullptr);
+			tcsetattr(b.tty, TCSAFLUSH, &b.saved_termios);
+			::close(b.tty);
+			b.tty = -1;
+		}
+	} guard{ *this, saved_resize };
+
+	while(not done) {
+		render();
+
+		const ssize_t n = read(tty, keys, sizeof(keys));
+		if(n < 0 and errno == EINTR)
+			continue;
+		if(n <= 0)
+			break;
+
+		message.clear();
+		for(ssize_t i = 0; i < n and not done; ++i) {
+			switch(keys[i]) {
+			case '\x1b':
+				if(i + 1 == n) {
+					done = true;
+				} else if(keys[i + 1] == '[' and i + 2 < n) {
+					switch(keys[i + 2]) {
+					case 'A': move(-1); break;
+					case 'B': move(1); break;
+					case 'H': move(-static_cast<long>(levels.back().rows.size())); break;
+					case 'F': move(levels.back().rows.size()); break;
+					case '5': move(-list_height); break;
+					case '6': move(list_height); break;
+					}
+					i += 2;
+					// skip the rest of longer sequences, such as "\x1b[5~"
+					while(i + 1 < n and keys[i] >= '0' and keys[i] <= '9')
+						++i;
+				} else {
+					++i;
+				}
+				break;
+			case '\x03': // Ctrl-C
+			case '\x04': // Ctrl-D
+				done = true;
+				break;
+			case '\r':
+			case '\n':
+				if(not input.empty()) {
+					add_term();
+				} else if(not levels.back().rows.empty()) {
+					picked = levels.back().rows[levels.back().selected];
+					done = true;
+				}
+				break;
+			case '\x7f': // backspace
+			case '\b':
+				if(not input.empty()) {
+					while(not input.empty() and (input.back() & 0xc0) == 0x80)
+						input.pop_back();
+					if(not input.empty())
+						input.pop_back();
+				} else if(levels.size() > 1) {
+					// the results before the last term are still there
+					levels.pop_back();
+				}
+				break;
+			case '\x15': // Ctrl-U
+				input.clear();
+				break;
+			default:
+				if(static_cast<unsigned char>(keys[i]) >= ' ')
+					input += keys[i];
+				break;
+			}
+		}
+	}
+
+	return picked;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "db.hpp"
+
+#include <map>
+#include <string>
+#include <termios.h>
+#include <vector>
+
+/*
+ * Interactive browser of recipes in the terminal. Each ingredient or tag
+ * entered narrows the recipes shown down to those that have it, intersecting
+ * the current results in memory. Results are kept on a stack, so removing the
+ * last term goes back to the results before it. Only the rows that fit on the
+ * screen are drawn.
+ */
+class browser {
+private:
+	struct level {
+		std::string term;
+		std::vector<int> rows; // indices of the recipes, in order
+		// position in the rows, kept for when the level is gone back to
+		size_t selected, scroll;
+	};
+
+	const recipe_set &recipes;
+	// indices of the recipes with each ingredient and tag, by lower-cased name
+	std::map<std::string, std::vector<int>> ingredients, tags;
+	std::vector<struct level> levels;
+	std::string input, message;
+	// rows of recipes that fit on the screen
+	int list_height;
+	int tty;
+	struct termios saved_termios;
+
+	const std::vector<int> *find_term(const std::string &term) const;
+	void add_term(void);
+	void move(const long rows);
+	void render(void);
+	void write_all(const std::string_view out);
+
+public:
+	/**
+	 * @param recipes Recipes to browse, sorted by ID.
+	 * @param ingredients IDs of the recipes with each ingredient, sorted.
+	 * @param tags IDs of the recipes with each tag, sorted.
+	 */
+	browser(const recipe_set &recipes,
+			const std::map<std::string, std::vector<int>> &ingredients,
+			const std::map<std::string, std::vector<int>> &tags);
+
+	/**
+	 * @brief Browse on the terminal until a recipe is picked (with Enter) or
+	 * the browser is left (with Esc or Ctrl-C).
+	 *
+	 * @return Index of the recipe picked, -1 if none.
+	 */
+	int run(void);
+};
@@ -15,21 +15,109 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include "alias.hpp"
+#include "bounded_queue.hpp"
+#include "browser.hpp"
 #include "cmd.hpp"
 #include "db.hpp"
+#include "dedupe.hpp"
+#include "jsonld.hpp"
+#include "merkle.hpp"
+#include "nutrition.hpp"
+#include "prefix_index.hpp"
 #include "util.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <format>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <getopt.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <span>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
+/*
+ * Recipes parsed by 'ingest' are stored this many at a time, each batch in a
+ * single transaction, so that the database is synced once per batch rather
+ * than once per row.
+ */
+#define INGEST_BATCH_SZ 4096
+/*
+ * Parsed files that may be waiting for the writer before the parsers block.
+ */
+#define INGEST_QUEUE_SZ 1024
+
+/*
+ * Split an ingredient such as "200 g flour" or "2 eggs" into its quantity,
+ * unit (if the word after the quantity is a known one) and name.
+ */
+static struct ingredient_amount parse_ingredient(std::string str, const std::map<std::string, struct unit> &units) {
+	struct ingredient_amount ingredient = { "", 0, "" };
+
+	trim(str);
+	if(parse_quantity(str, ingredient.quantity)) {
+		const size_t end = str.find_first_of(" \t");
+		std::string unit = str.substr(0, end);
+
+		std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+		if(end not_eq std::string::npos and units.contains(unit)) {
+			ingredient.unit = unit;
+			str.erase(0, end);
+			trim(str);
+		}
+	}
+	ingredient.name = str;
+
+	return ingredient;
+}
+
+/*
+ * Human-readable form of an ingredient amount, e.g. "1.5 kg flour".
+ */
+static std::string format_ingredient(struct ingredient_amount ingredient) {
+	if(ingredient.quantity == 0)
+		return ingredient.name;
+
+	if(ingredient.unit == "g" and ingredient.quantity >= 1000) {
+		ingredient.quantity /= 1000;
+		ingredient.unit = "kg";
+	} else if(ingredient.unit == "ml" and ingredient.quantity >= 1000) {
+		ingredient.quantity /= 1000;
+		ingredient.unit = "l";
+	}
+
+	if(ingredient.unit.empty())
+		return std::format("{:g} {}", ingredient.quantity, ingredient.name);
+	return std::format("{:g} {} {}", ingredient.quantity, ingredient.unit, ingredient.name);
+}
+
 int cmd_add(void) {
 	db db;
 	std::string name, description, ingredients, tags;
+	std::map<std::string, struct unit> units;
+	std::vector<int> ingr_ids, tag_ids;
+	std::vector<struct ingredient_amount> ingr_list;
 	int recipe_id, ingredient_id, tag_id;
 
 	std::cout << "Name: ";
@@ -49,45 +137,155 @@ int cmd_add(void) {
 	if((recipe_id = db.get_recipe_id(name)) <= 0)
 		recipe_id = db.add_recipe(name, description);
 
-	for(auto &ingredient : split(ingredients, ",")) {
-		trim(ingredient);
+	units = db.get_units();
+	for(auto &i : split_list(ingredients)) {
+		const struct ingredient_amount ingredient = parse_ingredient(i, units);
 
-		if((ingredient_id = db.get_ingredient_id(ingredient)) <= 0)
-			ingredient_id = db.add_ingredient(ingredient);
-		db.conn_recipe_ingredient(recipe_id, ingredient_id);
+		if((ingredient_id = db.get_ingredient_id(ingredient.name)) <= 0)
+			ingredient_id = db.add_ingredient(ingredient.name);
+		ingr_ids.push_back(ingredient_id);
+		ingr_list.push_back(ingredient);
 	}
+	// links and amounts go in together, in a single transaction
+	if(not ingr_ids.empty())
+		db.conn_recipes_ingredients({ recipe_id }, ingr_ids, ingr_list);
 
-	for(auto &tag : split(tags, ",")) {
-		trim(tag);
-
+	for(auto &tag : split_list(tags)) {
 		if((tag_id = db.get_tag_id(tag)) <= 0)
 			tag_id = db.add_tag(tag);
-		db.conn_recipe_tag(recipe_id, tag_id);
+		tag_ids.push_back(tag_id);
 	}
+	if(not tag_ids.empty())
+		db.conn_recipes_tags({ recipe_id }, tag_ids);
 
 	db.close();
 
 	return EXIT_SUCCESS;
 }
 
+/*
+ * Name a database is shown by in federated queries: its file name without the
+ * extension (e.g. "household" for ~/recipes/household.db).
+ */
+static std::string db_source_name(const std::string &path) {
+	return std::filesystem::path(path).stem().string();
+}
+
+/*
+ * Run a query on several databases concurrently, with a pool of threads each
+ * opening its own read-only connections, and pass the results to `output` in
+ * the order the databases were given as soon as they and all those before them
+ * are done. A database failing is reported without affecting the others.
+ *
+ * Returns false if the query failed on any database.
+ */
+template<typename T, typename Query, typename Output>
+static bool query_dbs(const std::vector<std::string> &paths, Query query, Output output) {
+	const size_t thread_num = std::min<size_t>(paths.size(), std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::promise<T>> promises(paths.size());
+	std::vector<std::future<T>> futures;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> next = 0;
+	bool ok = true;
+
+	for(auto &promise : promises)
+		futures.push_back(promise.get_future());
+
+	for(size_t t = 0; t < thread_num; ++t) {
+		threads.emplace_back([&]() {
+							 for(size_t i; (i = next++) < paths.size();) {
+								 try {
+									 db db;
+
+									 db.open_read_only(paths[i]);
+									 promises[i].set_value(query(db));
+								 } catch(...) {
+									 promises[i].set_exception(std::current_exception());
+								 }
+							 }
+							 });
+	}
+
+	for(size_t i = 0; i < paths.size(); ++i) {
+		try {
+			T result = futures[i].get();
+			output(paths[i], result);
+		} catch(const std::exception &e) {
+			std::cerr << paths[i] << ": " << e.what() << std::endl;
+			ok = false;
+		}
+	}
+
+	for(auto &thread : threads)
+		thread.join();
+
+	return ok;
+}
+
+/*
+ * Print recipes as a table, with the description column filling the rest of
+ * the terminal's width. If a source is given, it's shown in a first column.
+ */
+static void print_recipes(const std::span<const struct recipe_view> recipes,
+						  const std::string &source = "", const bool header = true) {
+	struct winsize winsize;
+	const int source_col_sz = source.empty() ? 0 : 12, id_col_sz = 5, name_col_sz = 24;
+
+	if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &winsize) == -1 or winsize.ws_col == 0)
+		winsize.ws_col = 80;
+	const int desc_col_sz = winsize.ws_col - (source_col_sz + id_col_sz + name_col_sz + 1);
+
+	if(header) {
+		if(source_col_sz)
+			std::cout << std::left << std::setw(source_col_sz) << "SOURCE";
+		std::cout << std::left << std::setw(id_col_sz) << "ID"
+			<< std::setw(name_col_sz) << "NAME"
+			<< std::setw(desc_col_sz) << "DESCRIPTION" << std::endl;
+	}
+
+	for(const auto &recipe : recipes) {
+		if(source_col_sz)
+			std::cout << std::left << std::setw(source_col_sz) << source;
+		std::cout << std::left << std::setw(id_col_sz) << recipe.id
+			<< std::setw(name_col_sz) << recipe.name
+			<< std::setw(desc_col_sz) << recipe.description << std::endl;
+	}
+}
+
 int cmd_list(int argc, char *argv[]) {
 	db db;
 	std::vector<std::string> ingredients, tags;
-	struct winsize winsize;
-	const int id_col_sz = 5, name_col_sz = 24;
+	const struct option long_opts[] = {
+		{ "max-kcal", required_argument, nullptr, 'k' },
+		{ "allow-subs", no_argument, nullptr, 's' },
+		{ "db", required_argument, nullptr, 'd' },
+		{ "verbose", no_argument, nullptr, 'v' },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	std::vector<std::string> db_paths;
+	double max_kcal = 0;
+	bool allow_subs = false, header = true, verbose = false;
 	int opt;
 
-	while((opt = getopt(argc, argv, "i:t:")) not_eq -1) {
+	while((opt = getopt_long(argc, argv, "i:t:k:sd:v", long_opts, nullptr)) not_eq -1) {
 		switch(opt) {
 		case 'i':
-			ingredients = split(optarg, ",");
-			for(auto &i : ingredients)
-				trim(i);
+			ingredients = split_list(optarg);
 			break;
 		case 't':
-			tags = split(optarg, ",");
-			for(auto &i : tags)
-				trim(i);
+			tags = split_list(optarg);
+			break;
+		case 'k':
+			max_kcal = std::stod(optarg);
+			break;
+		case 's':
+			allow_subs = true;
+			break;
+		case 'd':
+			db_paths.push_back(optarg);
+			break;
+		case 'v':
+			verbose = true;
 			break;
 		case '?':
 			std::cerr << "Unknown option '" << static_cast<char>(optopt)
@@ -96,116 +294,212 @@ int cmd_list(int argc, char *argv[]) {
 		}
 	}
 
-	ioctl(STDOUT_FILENO, TIOCGWINSZ, &winsize);
-	const int desc_col_sz = winsize.ws_col - (id_col_sz + name_col_sz + 1);
+	if(db_paths.empty())
+		db_paths = db::get_search_path();
 
-	db.open();
-
-	std::cout << std::left << std::setw(id_col_sz) << "ID"
-		<< std::setw(name_col_sz) << "NAME"
-		<< std::setw(desc_col_sz) << "DESCRIPTION" << std::endl;
+	if(not db_paths.empty()) {
+		if(verbose) {
+			std::cerr << "The query cache is only kept for the default database, so '--verbose' can't be used along with '--db' or MENU_HELPER_PATH." << std::endl;
+			return EXIT_FAILURE;
+		}
 
-	for(const auto &recipe : db.get_recipes(ingredients, tags)) {
-		std::cout << std::left << std::setw(id_col_sz) << recipe.id
-			<< std::setw(name_col_sz) << recipe.name
-			<< std::setw(desc_col_sz) << recipe.description << std::endl;
+		const bool ok = query_dbs<recipe_set>(db_paths,
+			[&](class db &db) {
+				// a name missing from a database just means no recipe of it matches
+				if(std::any_of(ingredients.begin(), ingredients.end(), [&](const auto &i) { return db.get_ingredient_id(i) <= 0; }) or
+				   std::any_of(tags.begin(), tags.end(), [&](const auto &t) { return db.get_tag_id(t) <= 0; }))
+					return recipe_set();
+				return db.get_recipes(ingredients, tags, max_kcal, allow_subs);
+			},
+			[&](const std::string &path, const recipe_set &recipes) {
+				print_recipes(recipes, db_paths.size() > 1 ? db_source_name(path) : "", header);
+				header = false;
+			});
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 
+	db.open();
+
+	print_recipes(db.get_recipes(ingredients, tags, max_kcal, allow_subs));
+
 	db.close();
 
+	if(verbose) {
+		const query_cache &cache = db.get_query_cache();
+		std::cerr << std::format("Query cache: {} hits, {} misses ({} hits, {} misses in total).",
+								 cache.hits, cache.misses, cache.total_hits, cache.total_misses) << std::endl;
+	}
+
 	return EXIT_SUCCESS;
 }
 
-int cmd_delete(int argc, char *argv[]) {
+int cmd_suggest(int argc, char *argv[]) {
 	db db;
-	std::vector<int> recipe_ids;
+	std::vector<std::string> ingredients, tags;
+	recipe_set candidates;
+	std::vector<struct recipe_view> suggestions;
+	std::vector<double> weights;
+	std::vector<bool> picked;
+	std::map<int, double> scores;
+	std::mt19937 rng(std::random_device{}());
+	size_t count = 1;
+	int opt;
 
-	if(argc < 1) {
-		std::cerr << "No specified IDs. Use 'help' for more information." << std::endl;
-		return EXIT_FAILURE;
+	while((opt = getopt(argc, argv, "i:t:n:")) not_eq -1) {
+		switch(opt) {
+		case 'i':
+			ingredients = split_list(optarg);
+			break;
+		case 't':
+			tags = split_list(optarg);
+			break;
+		case 'n':
+			count = std::stoul(optarg);
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
 	}
 
 	db.open();
 
-	for(int i = 0; i < argc; ++i) {
-		const int id = std::stoi(argv[i]);
+	candidates = db.get_recipes(ingredients, tags);
+	scores = db.get_recipe_scores(std::time(nullptr));
 
-		if(not db.recipe_exists(id)) {
-			std::cerr << "No recipe exists with ID " << id << "." << std::endl;
-			db.close();
-			return EXIT_FAILURE;
-		} else {
-			recipe_ids.push_back(id);
-		}
+	db.close();
+
+	if(candidates.empty())
+		return EXIT_SUCCESS;
+
+	// the more (and the more recently) a recipe was cooked, the less likely
+	for(const auto &recipe : candidates) {
+		const auto score = scores.find(recipe.id);
+		weights.push_back(1 / (1 + 4 * (score == scores.end() ? 0 : score->second)));
 	}
 
-	db.del_recipes(recipe_ids);
-	db.close();
+	const alias_table table(weights);
+	picked.resize(candidates.size());
+	count = std::min(count, candidates.size());
+
+	// draw without replacement by rejecting recipes already suggested
+	while(suggestions.size() < count) {
+		const size_t i = table.sample(rng);
+
+		if(picked[i])
+			continue;
+		picked[i] = true;
+		suggestions.push_back(candidates[i]);
+	}
+
+	print_recipes(suggestions);
 
 	return EXIT_SUCCESS;
 }
 
-int cmd_info(const int id) {
+int cmd_similar(int argc, char *argv[]) {
 	db db;
-	struct recipe recipe;
-	std::vector<std::string> ingredients, tags;
+	std::vector<struct scored_recipe> recipes;
+	const int id_col_sz = 5, name_col_sz = 24;
+	int opt, count = 10, id;
 
-	db.open();
+	while((opt = getopt(argc, argv, "n:")) not_eq -1) {
+		switch(opt) {
+		case 'n':
+			count = std::stoi(optarg);
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(optind not_eq argc - 1) {
+		std::cerr << "No specified ID. Use 'help' for more information." << std::endl;
+		return EXIT_FAILURE;
+	}
+	id = std::stoi(argv[optind]);
 
+	db.open();
 	if(not db.recipe_exists(id)) {
-		std::cerr << "No recipe with ID '" << id << "'";
+		std::cerr << "Recipe with ID " << id << " does not exist." << std::endl;
 		db.close();
 		return EXIT_FAILURE;
 	}
 
-	recipe = db.get_recipe(id);
-	ingredients = db.get_recipe_ingredients(id);
-	tags = db.get_recipe_tags(id);
+	recipes = db.get_similar_recipes(id, count);
 
 	db.close();
 
-	std::cout << "Name: " << recipe.name << "\n"
-		<< "Description: " << recipe.description << "\n"
-		<< "ID: " << recipe.id << "\n"
-		<< std::endl;
-
-	std::cout << "Ingredients:" << std::endl;
-	for(auto &ingredient : ingredients)
-		std::cout << "\t- " << ingredient << std::endl;
-	std::cout << std::endl;
+	std::cout << std::left << std::setw(id_col_sz) << "ID"
+		<< std::setw(name_col_sz) << "NAME"
+		<< "SIMILARITY" << std::endl;
 
-	std::cout << "Tags:" << std::endl;
-	for(auto &tag : tags)
-		std::cout << "\t- " << tag << std::endl;
-	std::cout << std::endl;
+	for(const auto &similar : recipes) {
+		std::cout << std::left << std::setw(id_col_sz) << similar.recipe.id
+			<< std::setw(name_col_sz) << similar.recipe.name
+			<< static_cast<int>(similar.score * 100) << "%" << std::endl;
+	}
 
 	return EXIT_SUCCESS;
 }
 
-int cmd_edit_name(const int id) {
+int cmd_dedupe(int argc, char *argv[]) {
 	db db;
-	std::string new_name;
+	std::vector<std::vector<int>> clusters;
+	std::map<int, std::string_view> names;
+	const int id_col_sz = 5;
+	const struct option long_opts[] = {
+		{ "merge", no_argument, nullptr, 'm' },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	int opt, similarity = 70;
+	bool merge = false;
+
+	while((opt = getopt_long(argc, argv, "s:m", long_opts, nullptr)) not_eq -1) {
+		switch(opt) {
+		case 's':
+			similarity = std::stoi(optarg);
+			break;
+		case 'm':
+			merge = true;
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
 
 	db.open();
-	if(not db.recipe_exists(id)) {
-		std::cerr << "Recipe with ID " << id << " does not exist." << std::endl;
-		db.close();
-		return EXIT_FAILURE;
-	}
 
-	std::cout << "New name: ";
-	std::getline(std::cin, new_name);
+	const recipe_set recipes = db.get_recipes({}, {});
+	clusters = find_duplicates(recipes, db.get_all_recipe_ingredient_ids(),
+							   db.get_ingredient_buckets(), similarity / 100.0);
 
-	db.update_recipe_name(id, new_name);
+	for(const auto &recipe : recipes)
+		names[recipe.id] = recipe.name;
+
+	for(const auto &cluster : clusters) {
+		for(auto id : cluster)
+			std::cout << std::left << std::setw(id_col_sz) << id << names[id] << std::endl;
+
+		if(merge) {
+			db.merge_recipes(cluster.front(), cluster);
+			std::cout << "Merged into recipe with ID " << cluster.front() << "." << std::endl;
+		}
+		std::cout << std::endl;
+	}
 
 	db.close();
 
 	return EXIT_SUCCESS;
 }
 
-int cmd_edit_desc(const int id) {
+int cmd_cooked(const int id) {
 	db db;
-	std::string new_desc;
 
 	db.open();
 	if(not db.recipe_exists(id)) {
@@ -214,126 +508,1274 @@ int cmd_edit_desc(const int id) {
 		return EXIT_FAILURE;
 	}
 
-	std::cout << "New name: ";
-	std::getline(std::cin, new_desc);
-
-	db.update_recipe_desc(id, new_desc);
+	db.add_cooked(id, std::time(nullptr));
 
 	db.close();
 
 	return EXIT_SUCCESS;
 }
 
-int cmd_add_ingr(const int recipe_id, const char *ingredients) {
+int cmd_shopping_list(int argc, char *argv[]) {
 	db db;
-	std::vector<std::string> ingr_list = split(ingredients, ",");
+	std::vector<int> recipe_ids;
 
-	db.open();
-	if(not db.recipe_exists(recipe_id)) {
-		std::cerr << "Recipe with ID " << recipe_id << " does not exist." << std::endl;
-		db.close();
+	if(argc < 1) {
+		std::cerr << "No specified IDs. Use 'help' for more information." << std::endl;
 		return EXIT_FAILURE;
 	}
 
-	for(auto &i : ingr_list) {
-		int ingr_id;
-		trim(i);
+	for(int i = 0; i < argc; ++i)
+		recipe_ids.push_back(std::stoi(argv[i]));
 
-		if(not db.ingredient_exists(i))
-			ingr_id = db.add_ingredient(i);
-		else
-			ingr_id = db.get_ingredient_id(i);
+	db.open();
 
-		db.conn_recipe_ingredient(recipe_id, ingr_id);
+	const std::vector<int> existing = db.get_existing_recipe_ids(recipe_ids);
+	for(auto id : recipe_ids) {
+		if(std::find(existing.begin(), existing.end(), id) == existing.end()) {
+			std::cerr << "No recipe exists with ID " << id << "." << std::endl;
+			db.close();
+			return EXIT_FAILURE;
+		}
 	}
 
+	for(const auto &ingredient : db.get_shopping_list(recipe_ids))
+		std::cout << "- " << format_ingredient(ingredient) << std::endl;
+
 	db.close();
 
 	return EXIT_SUCCESS;
 }
 
-int cmd_rm_ingr(const int recipe_id, const char *ingredients) {
+int cmd_set_nutrition(const char *ingredient, const char *amount, const char *values) {
 	db db;
-	std::vector<std::string> ingr_list = split(ingredients, ",");
-
-	db.open();
-	if(not db.recipe_exists(recipe_id)) {
-		std::cerr << "Recipe with ID " << recipe_id << " does not exist." << std::endl;
-		db.close();
+	std::map<std::string, struct unit> units;
+	nutrient_vec nutrition = {};
+	std::string per = amount, unit;
+	double quantity;
+	int ingr_id;
+
+	trim(per);
+	per += " ";
+	if(not parse_quantity(per, quantity) or quantity <= 0) {
+		std::cerr << "Invalid amount '" << amount << "'. Use 'help' for more information." << std::endl;
 		return EXIT_FAILURE;
 	}
+	trim(per);
 
-	for(auto &i : ingr_list) {
-		int ingr_id;
-		trim(i);
+	for(const auto &i : split_view(values, ",")) {
+		const size_t eq = i.find('=');
+		const std::string name(trim_view(i.substr(0, eq)));
+		int index;
 
-		if(not db.ingredient_exists(i)) {
-			std::cerr << "Could not find ingredient '" << i << "'. Skipping!" << std::endl;
-			continue;
+		if(eq == std::string_view::npos or (index = nutrient_index(name)) < 0) {
+			std::cerr << "Unknown nutrient '" << name << "'. Use 'man menu-helper' for a list." << std::endl;
+			return EXIT_FAILURE;
 		}
+		nutrition[index] = std::stof(std::string(i.substr(eq + 1)));
+	}
 
-		ingr_id = db.get_ingredient_id(i);
-		db.disconn_recipe_ingredient(recipe_id, ingr_id);
+	db.open();
+
+	units = db.get_units();
+	if(not per.empty()) {
+		const auto u = units.find(per);
+
+		if(u == units.end()) {
+			std::cerr << "Unknown unit '" << per << "'." << std::endl;
+			db.close();
+			return EXIT_FAILURE;
+		}
+		unit = u->second.base;
+		quantity *= u->second.factor;
 	}
 
+	// store the nutrients of a single gram, millilitre, or item
+	for(auto &value : nutrition)
+		value /= quantity;
+
+	if((ingr_id = db.get_ingredient_id(ingredient)) <= 0)
+		ingr_id = db.add_ingredient(ingredient);
+	db.set_ingredient_nutrition(ingr_id, unit, nutrition);
+
 	db.close();
 
 	return EXIT_SUCCESS;
 }
 
-int cmd_add_tag(const int recipe_id, const char *tags) {
+int cmd_nutrition(int argc, char *argv[]) {
 	db db;
-	std::vector<std::string> tag_list = split(tags, ",");
+	std::vector<int> recipe_ids;
+	std::map<int, struct recipe_nutrition> nutrition;
+	nutrient_vec total = {};
 
-	db.open();
-	if(not db.recipe_exists(recipe_id)) {
-		std::cerr << "Recipe with ID " << recipe_id << " does not exist." << std::endl;
-		db.close();
+	if(argc < 1) {
+		std::cerr << "No specified IDs. Use 'help' for more information." << std::endl;
 		return EXIT_FAILURE;
 	}
 
-	for(auto &i : tag_list) {
-		int tag_id;
-		trim(i);
+	for(int i = 0; i < argc; ++i)
+		recipe_ids.push_back(std::stoi(argv[i]));
 
-		if(not db.tag_exists(i))
-			tag_id = db.add_tag(i);
-		else
-			tag_id = db.get_ingredient_id(i);
+	db.open();
+
+	nutrition = db.get_recipe_nutrition(recipe_ids);
+
+	for(auto id : recipe_ids) {
+		if(not nutrition.contains(id)) {
+			std::cerr << "No recipe exists with ID " << id << "." << std::endl;
+			db.close();
+			return EXIT_FAILURE;
+		}
+	}
 
-		db.conn_recipe_tag(recipe_id, tag_id);
+	auto print_nutrition = [](const nutrient_vec &values) {
+		for(int i = 0; i < NUTRIENT_NUM; ++i) {
+			if(values[i] not_eq 0)
+				std::cout << "\t" << nutrients[i].name << ": " << std::format("{:g}", values[i])
+					<< " " << nutrients[i].unit << std::endl;
+		}
+		std::cout << std::endl;
+	};
+
+	for(auto id : recipe_ids) {
+		const struct recipe_nutrition &recipe = nutrition[id];
+
+		std::cout << db.get_recipe(id).name << " (" << id << "):";
+		if(recipe.counted < recipe.ingredients)
+			std::cout << " counting " << recipe.counted << " of " << recipe.ingredients << " ingredients";
+		std::cout << std::endl;
+		print_nutrition(recipe.nutrients);
+		nutrient_add_scaled(total.data(), recipe.nutrients.data(), 1);
 	}
 
 	db.close();
 
+	if(recipe_ids.size() > 1) {
+		std::cout << "Total:" << std::endl;
+		print_nutrition(total);
+	}
+
 	return EXIT_SUCCESS;
 }
 
-int cmd_rm_tag(const int recipe_id, const char *tags) {
+int cmd_delete(int argc, char *argv[]) {
 	db db;
-	std::vector<std::string> tag_list = split(tags, ",");
+	std::vector<int> recipe_ids;
 
-	db.open();
-	if(not db.recipe_exists(recipe_id)) {
-		std::cerr << "Recipe with ID " << recipe_id << " does not exist." << std::endl;
-		db.close();
+	if(argc < 1) {
+		std::cerr << "No specified IDs. Use 'help' for more information." << std::endl;
 		return EXIT_FAILURE;
 	}
 
-	for(auto &i : tag_list) {
-		int tag_id;
-		trim(i);
+	db.open();
 
-		if(not db.tag_exists(i)) {
-			std::cerr << "Could not find tag '" << i << "'. Skipping!" << std::endl;
-			continue;
-		}
+	for(int i = 0; i < argc; ++i) {
+		const int id = std::stoi(argv[i]);
 
-		tag_id = db.get_tag_id(i);
-		db.disconn_recipe_tag(recipe_id, tag_id);
+		if(not db.recipe_exists(id)) {
+			std::cerr << "No recipe exists with ID " << id << "." << std::endl;
+			db.close();
+			return EXIT_FAILURE;
+		} else {
+			recipe_ids.push_back(id);
+		}
 	}
 
+	db.del_recipes(recipe_ids);
 	db.close();
 
 	return EXIT_SUCCESS;
 }
+
+struct recipe_info {
+	struct recipe recipe;
+	std::vector<struct ingredient_amount> ingredients;
+	name_set tags;
+	std::vector<struct attachment> attachments;
+};
+
+static std::optional<struct recipe_info> get_recipe_info(db &db, const int id) {
+	if(not db.recipe_exists(id))
+		return std::nullopt;
+
+	return recipe_info{
+		db.get_recipe(id),
+		db.get_recipe_ingredient_amounts(id),
+		db.get_recipe_tags(id),
+		db.get_recipe_attachments(id),
+	};
+}
+
+static void print_recipe_info(const struct recipe_info &info, const std::string &source) {
+	std::cout << "Name: " << info.recipe.name << "\n"
+		<< "Description: " << info.recipe.description << "\n"
+		<< "ID: " << info.recipe.id << "\n";
+	if(not source.empty())
+		std::cout << "Source: " << source << "\n";
+	std::cout << std::endl;
+
+	std::cout << "Ingredients:" << std::endl;
+	for(auto &ingredient : info.ingredients)
+		std::cout << "\t- " << format_ingredient(ingredient) << std::endl;
+	std::cout << std::endl;
+
+	std::cout << "Tags:" << std::endl;
+	for(auto &tag : info.tags)
+		std::cout << "\t- " << tag << std::endl;
+	std::cout << std::endl;
+
+	if(not info.attachments.empty()) {
+		std::cout << "Attachments:" << std::endl;
+		for(auto &attachment : info.attachments)
+			std::cout << "\t- " << attachment.name << " (" << attachment.size << " bytes)" << std::endl;
+		std::cout << std::endl;
+	}
+}
+
+int cmd_info(int argc, char *argv[]) {
+	db db;
+	const struct option long_opts[] = {
+		{ "db", required_argument, nullptr, 'd' },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	std::vector<std::string> db_paths;
+	std::optional<struct recipe_info> info;
+	bool found = false;
+	int id, opt;
+
+	while((opt = getopt_long(argc, argv, "d:", long_opts, nullptr)) not_eq -1) {
+		switch(opt) {
+		case 'd':
+			db_paths.push_back(optarg);
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(optind not_eq argc - 1) {
+		std::cerr << "Invalid number of arguments. Use 'help' subcommand for more information." << std::endl;
+		return EXIT_FAILURE;
+	}
+	id = std::stoi(argv[optind]);
+
+	if(db_paths.empty())
+		db_paths = db::get_search_path();
+
+	// IDs are per database, so show the recipe with the ID in each of them
+	if(not db_paths.empty()) {
+		const bool ok = query_dbs<std::optional<struct recipe_info>>(db_paths,
+			[&](class db &db) {
+				return get_recipe_info(db, id);
+			},
+			[&](const std::string &path, const std::optional<struct recipe_info> &info) {
+				if(not info)
+					return;
+				print_recipe_info(*info, db_paths.size() > 1 ? db_source_name(path) : "");
+				found = true;
+			});
+		if(not found)
+			std::cerr << "No recipe with ID '" << id << "'" << std::endl;
+		return ok and found ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	db.open();
+	info = get_recipe_info(db, id);
+	db.close();
+
+	if(not info) {
+		std::cerr << "No recipe with ID '" << id << "'";
+		return EXIT_FAILURE;
+	}
+
+	print_recipe_info(*info, "");
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_edit_name(const int id) {
+	db db;
+	std::string new_name;
+
+	db.open();
+	if(not db.recipe_exists(id)) {
+		std::cerr << "Recipe with ID " << id << " does not exist." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "New name: ";
+	std::getline(std::cin, new_name);
+
+	db.update_recipe_name(id, new_name);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_edit_desc(const int id) {
+	db db;
+	std::string new_desc;
+
+	db.open();
+	if(not db.recipe_exists(id)) {
+		std::cerr << "Recipe with ID " << id << " does not exist." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "New name: ";
+	std::getline(std::cin, new_desc);
+
+	db.update_recipe_desc(id, new_desc);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Parse the arguments shared by the bulk editing commands, which are of the
+ * form "[-i <ingredients>] [-t <tags>] [<ids>] <list>", selecting recipes
+ * either by a comma-separated list of IDs or by the same filters as 'list'.
+ */
+static bool select_recipes(int argc, char *argv[], db &db,
+						   std::vector<int> &recipe_ids, std::string &list)
+{
+	std::vector<std::string> ingredients, tags;
+	int opt;
+
+	while((opt = getopt(argc, argv, "i:t:")) not_eq -1) {
+		switch(opt) {
+		case 'i':
+			ingredients = split_list(optarg);
+			break;
+		case 't':
+			tags = split_list(optarg);
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return false;
+		}
+	}
+
+	if(optind == argc - 2) {
+		if(not ingredients.empty() or not tags.empty()) {
+			std::cerr << "Cannot select recipes by both IDs and filters." << std::endl;
+			return false;
+		}
+
+		for(const auto &i : split_view(argv[optind], ","))
+			recipe_ids.push_back(std::stoi(std::string(i)));
+
+		const std::vector<int> existing = db.get_existing_recipe_ids(recipe_ids);
+		for(auto id : recipe_ids) {
+			if(std::find(existing.begin(), existing.end(), id) == existing.end()) {
+				std::cerr << "Recipe with ID " << id << " does not exist." << std::endl;
+				return false;
+			}
+		}
+	} else if(optind == argc - 1 and (not ingredients.empty() or not tags.empty())) {
+		for(const auto &recipe : db.get_recipes(ingredients, tags))
+			recipe_ids.push_back(recipe.id);
+	} else {
+		std::cerr << "Invalid arguments. Use 'help' for more information." << std::endl;
+		return false;
+	}
+
+	list = argv[argc - 1];
+
+	return true;
+}
+
+int cmd_add_ingr(int argc, char *argv[]) {
+	db db;
+	std::vector<int> recipe_ids, ingr_ids;
+	std::vector<struct ingredient_amount> ingr_list;
+	std::map<std::string, struct unit> units;
+	std::string ingredients;
+
+	db.open();
+	if(not select_recipes(argc, argv, db, recipe_ids, ingredients)) {
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	units = db.get_units();
+	for(auto &i : split_list(ingredients)) {
+		const struct ingredient_amount ingredient = parse_ingredient(i, units);
+		int ingr_id;
+
+		if((ingr_id = db.get_ingredient_id(ingredient.name)) <= 0)
+			ingr_id = db.add_ingredient(ingredient.name);
+		ingr_ids.push_back(ingr_id);
+		ingr_list.push_back(ingredient);
+	}
+
+	if(not recipe_ids.empty())
+		db.conn_recipes_ingredients(recipe_ids, ingr_ids, ingr_list);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_rm_ingr(int argc, char *argv[]) {
+	db db;
+	std::vector<int> recipe_ids, ingr_ids;
+	std::string ingredients;
+
+	db.open();
+	if(not select_recipes(argc, argv, db, recipe_ids, ingredients)) {
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	for(auto &i : split_list(ingredients)) {
+		int ingr_id;
+
+		if((ingr_id = db.get_ingredient_id(i)) <= 0) {
+			std::cerr << "Could not find ingredient '" << i << "'. Skipping!" << std::endl;
+			continue;
+		}
+		ingr_ids.push_back(ingr_id);
+	}
+
+	if(not recipe_ids.empty() and not ingr_ids.empty())
+		db.disconn_recipes_ingredients(recipe_ids, ingr_ids);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_add_tag(int argc, char *argv[]) {
+	db db;
+	std::vector<int> recipe_ids, tag_ids;
+	std::string tags;
+
+	db.open();
+	if(not select_recipes(argc, argv, db, recipe_ids, tags)) {
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	for(auto &i : split_list(tags)) {
+		int tag_id;
+
+		if((tag_id = db.get_tag_id(i)) <= 0)
+			tag_id = db.add_tag(i);
+		tag_ids.push_back(tag_id);
+	}
+
+	if(not recipe_ids.empty())
+		db.conn_recipes_tags(recipe_ids, tag_ids);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_rm_tag(int argc, char *argv[]) {
+	db db;
+	std::vector<int> recipe_ids, tag_ids;
+	std::string tags;
+
+	db.open();
+	if(not select_recipes(argc, argv, db, recipe_ids, tags)) {
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	for(auto &i : split_list(tags)) {
+		int tag_id;
+
+		if((tag_id = db.get_tag_id(i)) <= 0) {
+			std::cerr << "Could not find tag '" << i << "'. Skipping!" << std::endl;
+			continue;
+		}
+		tag_ids.push_back(tag_id);
+	}
+
+	if(not recipe_ids.empty() and not tag_ids.empty())
+		db.disconn_recipes_tags(recipe_ids, tag_ids);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_merge_ingr(const char *ingredients, const char *into) {
+	db db;
+	std::vector<int> ingr_ids;
+	int into_id;
+
+	db.open();
+
+	for(auto &i : split_list(ingredients)) {
+		int ingr_id;
+
+		if((ingr_id = db.get_ingredient_id(i)) <= 0) {
+			std::cerr << "Could not find ingredient '" << i << "'. Skipping!" << std::endl;
+			continue;
+		}
+		ingr_ids.push_back(ingr_id);
+	}
+
+	if((into_id = db.get_ingredient_id(into)) <= 0)
+		into_id = db.add_ingredient(into);
+
+	if(not ingr_ids.empty())
+		db.merge_ingredients(ingr_ids, into_id);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_merge_tag(const char *tags, const char *into) {
+	db db;
+	std::vector<int> tag_ids;
+	int into_id;
+
+	db.open();
+
+	for(auto &i : split_list(tags)) {
+		int tag_id;
+
+		if((tag_id = db.get_tag_id(i)) <= 0) {
+			std::cerr << "Could not find tag '" << i << "'. Skipping!" << std::endl;
+			continue;
+		}
+		tag_ids.push_back(tag_id);
+	}
+
+	if((into_id = db.get_tag_id(into)) <= 0)
+		into_id = db.add_tag(into);
+
+	if(not tag_ids.empty())
+		db.merge_tags(tag_ids, into_id);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_move_tag(const char *tag, const char *parent) {
+	db db;
+	int tag_id, parent_id = 0;
+
+	db.open();
+
+	if((tag_id = db.get_tag_id(tag)) <= 0)
+		tag_id = db.add_tag(tag);
+	if(*parent and (parent_id = db.get_tag_id(parent)) <= 0)
+		parent_id = db.add_tag(parent);
+
+	db.set_tag_parent(tag_id, parent_id);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Print the tags under a parent (0 for the top-level ones), each indented as
+ * deep as it is followed by its own children.
+ */
+static void print_tag_tree(const std::map<int, std::vector<struct tag_node>> &children,
+						   const int parent_id, const int depth) {
+	if(not children.contains(parent_id))
+		return;
+
+	for(const auto &tag : children.at(parent_id)) {
+		std::cout << std::string(depth, '\t') << tag.name << " (" << tag.recipes << ")" << std::endl;
+		print_tag_tree(children, tag.id, depth + 1);
+	}
+}
+
+int cmd_tags(void) {
+	db db;
+	std::map<int, std::vector<struct tag_node>> children;
+
+	db.open();
+
+	for(auto &tag : db.get_tag_tree())
+		children[tag.parent_id].push_back(tag);
+
+	db.close();
+
+	print_tag_tree(children, 0, 0);
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_rename_ingr(const char *name, const char *new_name) {
+	db db;
+	int ingr_id;
+
+	db.open();
+
+	if((ingr_id = db.get_ingredient_id(name)) <= 0) {
+		std::cerr << "Could not find ingredient '" << name << "'." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	if(db.ingredient_exists(new_name)) {
+		std::cerr << "Ingredient '" << new_name << "' already exists. Use 'merge-ingr' instead." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	db.rename_ingredient(ingr_id, new_name);
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_add_sub(const char *ingredient, const char *substitutes, const char *weight) {
+	db db;
+	int ingr_id;
+
+	db.open();
+
+	if((ingr_id = db.get_ingredient_id(ingredient)) <= 0)
+		ingr_id = db.add_ingredient(ingredient);
+
+	for(auto &i : split_list(substitutes)) {
+		int sub_id;
+
+		if((sub_id = db.get_ingredient_id(i)) <= 0)
+			sub_id = db.add_ingredient(i);
+		db.add_substitute(ingr_id, sub_id, weight ? std::stod(weight) : 1);
+	}
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_rm_sub(const char *ingredient, const char *substitutes) {
+	db db;
+	int ingr_id;
+
+	db.open();
+
+	if((ingr_id = db.get_ingredient_id(ingredient)) <= 0) {
+		std::cerr << "Could not find ingredient '" << ingredient << "'." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	for(auto &i : split_list(substitutes)) {
+		int sub_id;
+
+		if((sub_id = db.get_ingredient_id(i)) <= 0) {
+			std::cerr << "Could not find ingredient '" << i << "'. Skipping!" << std::endl;
+			continue;
+		}
+		db.del_substitute(ingr_id, sub_id);
+	}
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_subs(const char *ingredient) {
+	db db;
+	int ingr_id;
+
+	db.open();
+
+	if((ingr_id = db.get_ingredient_id(ingredient)) <= 0) {
+		std::cerr << "Could not find ingredient '" << ingredient << "'." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	for(const auto &sub : db.get_substitutes(ingr_id))
+		std::cout << "\t- " << sub << std::endl;
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_attach(const int recipe_id, const char *path) {
+	db db;
+	std::ifstream file(path, std::ios::binary);
+	const std::string name = std::filesystem::path(path).filename();
+
+	if(not file.is_open()) {
+		std::cerr << "Failed to open file '" << path << "'." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	db.open();
+	if(not db.recipe_exists(recipe_id)) {
+		std::cerr << "Recipe with ID " << recipe_id << " does not exist." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	db.add_attachment(recipe_id, name, file, std::filesystem::file_size(path));
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_attachment(const int recipe_id, const char *name) {
+	db db;
+
+	db.open();
+	if(not db.recipe_exists(recipe_id)) {
+		std::cerr << "Recipe with ID " << recipe_id << " does not exist." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	if(not db.read_attachment(recipe_id, name, std::cout)) {
+		std::cerr << "Recipe with ID " << recipe_id << " has no attachment '" << name << "'." << std::endl;
+		db.close();
+		return EXIT_FAILURE;
+	}
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_complete(const char *kind, const char *prefix) {
+	static const std::map<std::string, enum name_kind> kinds = {
+		{ "ingredient", NAMES_INGREDIENTS },
+		{ "tag", NAMES_TAGS },
+		{ "recipe", NAMES_RECIPES },
+		{ "id", NAMES_RECIPE_IDS },
+	};
+	std::vector<std::string> values;
+	const auto name_kind = kinds.find(kind);
+
+	if(name_kind == kinds.end()) {
+		std::cerr << "Unknown kind of name '" << kind << "'. Use 'help' for more information." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::string path = db::get_name_index_path(name_kind->second);
+
+	// only touch the database if the index was never built
+	if(not lookup_prefix_index(path, prefix, values)) {
+		db db;
+
+		db.open();
+		db.rebuild_name_index(name_kind->second);
+		db.close();
+
+		if(not lookup_prefix_index(path, prefix, values))
+			return EXIT_FAILURE;
+	}
+
+	for(const auto &value : values)
+		std::cout << value << "\n";
+	std::cout << std::flush;
+
+	return EXIT_SUCCESS;
+}
+
+struct ingest_result {
+	std::string path;
+	std::vector<struct recipe_import> recipes;
+	std::string error;
+};
+
+/*
+ * Extract the recipes of a saved web page (or JSON-LD file), reading it
+ * through a memory mapping rather than copying it.
+ */
+static std::vector<struct ld_recipe> read_ld_recipes(const std::filesystem::path &path, const bool html) {
+	std::vector<struct ld_recipe> recipes;
+	struct stat st;
+	void *data;
+	const int fd = open(path.c_str(), O_RDONLY);
+
+	if(fd == -1)
+		throw std::runtime_error(std::format("Failed to open file: {}.", std::strerror(errno)));
+	if(fstat(fd, &st) == -1) {
+		close(fd);
+		throw std::runtime_error(std::format("Failed to stat file: {}.", std::strerror(errno)));
+	}
+	if(st.st_size == 0) {
+		close(fd);
+		return recipes;
+	}
+
+	data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		throw std::runtime_error(std::format("Failed to map file: {}.", std::strerror(errno)));
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	try {
+		recipes = extract_ld_recipes(std::string_view(static_cast<const char*>(data), st.st_size), html);
+	} catch(...) {
+		munmap(data, st.st_size);
+		throw;
+	}
+	munmap(data, st.st_size);
+
+	return recipes;
+}
+
+static struct recipe_import to_recipe_import(const struct ld_recipe &ld, const std::map<std::string, struct unit> &units) {
+	struct recipe_import recipe = { ld.name, ld.description, {}, ld.keywords, 0, 0 };
+
+	for(auto line : ld.ingredients) {
+		size_t open;
+
+		// drop preparation notes, e.g. "1 (14 oz) can tomatoes, drained"
+		while((open = line.find('(')) not_eq std::string::npos) {
+			const size_t close = line.find(')', open);
+			line.erase(open, close == std::string::npos ? std::string::npos : close - open + 1);
+		}
+		line = line.substr(0, line.find(','));
+
+		const struct ingredient_amount ingredient = parse_ingredient(line, units);
+		if(not ingredient.name.empty())
+			recipe.ingredients.push_back(ingredient);
+	}
+
+	return recipe;
+}
+
+int cmd_ingest(const char *dir) {
+	db db;
+	std::vector<std::filesystem::path> paths;
+	std::map<std::string, struct unit> units;
+	bounded_queue<struct ingest_result> queue(INGEST_QUEUE_SZ);
+	std::unordered_map<std::string, int> ingredient_ids, tag_ids;
+	std::vector<struct recipe_import> batch;
+	// file each recipe of the batch came from
+	std::vector<std::string> batch_paths;
+	std::vector<std::thread> threads;
+	const size_t thread_num = std::max(1u, std::thread::hardware_concurrency());
+	std::atomic<size_t> next = 0, running = thread_num;
+	size_t file_num = 0, recipe_num = 0, added = 0, skipped_files = 0, failed_files = 0, failed_recipes = 0;
+	const auto start = std::chrono::steady_clock::now();
+
+	for(const auto &entry : std::filesystem::recursive_directory_iterator(dir,
+			std::filesystem::directory_options::skip_permission_denied)) {
+		std::string ext = entry.path().extension().string();
+
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if(entry.is_regular_file() and (ext == ".html" or ext == ".htm" or ext == ".json" or ext == ".jsonld"))
+			paths.push_back(entry.path());
+	}
+
+	db.open();
+	units = db.get_units();
+
+	// parse on every core, while this thread is the only one writing
+	for(size_t t = 0; t < thread_num; ++t) {
+		threads.emplace_back([&]() {
+							 for(size_t i; (i = next++) < paths.size();) {
+								 const std::string ext = paths[i].extension().string();
+								 struct ingest_result result = { paths[i].string(), {}, "" };
+
+								 try {
+									 const bool html = ext.size() > 1 and std::tolower(ext[1]) == 'h';
+
+									 for(const auto &ld : read_ld_recipes(paths[i], html))
+										 result.recipes.push_back(to_recipe_import(ld, units));
+								 } catch(const std::exception &e) {
+									 result.error = e.what();
+								 }
+								 queue.push(std::move(result));
+							 }
+							 if(--running == 0)
+								 queue.close();
+							 });
+	}
+
+	/*
+	 * Anything import_recipes throws is caught here, as unwinding past the
+	 * parsing threads would end the program.
+	 */
+	auto store_batch = [&]() {
+		try {
+			added += db.import_recipes(batch, ingredient_ids, tag_ids);
+		} catch(const std::exception &e) {
+			std::vector<std::string> paths = batch_paths;
+
+			paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+			for(const auto &path : paths)
+				std::cerr << path << ": Failed to store recipes: " << e.what() << std::endl;
+			failed_recipes += batch.size();
+		}
+		batch.clear();
+		batch_paths.clear();
+	};
+
+	while(auto result = queue.pop()) {
+		++file_num;
+		if(not result->error.empty()) {
+			std::cerr << result->path << ": " << result->error << std::endl;
+			++failed_files;
+			continue;
+		}
+		// most pages of an archive aren't recipes, which isn't an error
+		if(result->recipes.empty()) {
+			++skipped_files;
+			continue;
+		}
+
+		recipe_num += result->recipes.size();
+		batch_paths.insert(batch_paths.end(), result->recipes.size(), result->path);
+		std::move(result->recipes.begin(), result->recipes.end(), std::back_inserter(batch));
+		if(batch.size() >= INGEST_BATCH_SZ)
+			store_batch();
+	}
+	if(not batch.empty())
+		store_batch();
+
+	for(auto &thread : threads)
+		thread.join();
+
+	db.close();
+
+	const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::format("Read {} recipes from {} files in {:.2f} s ({:.0f} files/s, {:.0f} recipes/s).\n",
+							 recipe_num, file_num, secs, file_num / secs, recipe_num / secs)
+		<< std::format("Added {} new recipes. Skipped {} files without recipes. Failed to read {} files and to store {} recipes.",
+					   added, skipped_files, failed_files, failed_recipes) << std::endl;
+
+	return failed_files == 0 and failed_recipes == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int cmd_backup(int argc, char *argv[]) {
+	db db;
+	const struct option long_opts[] = {
+		{ "pages", required_argument, nullptr, 'p' },
+		{ "verify", no_argument, nullptr, 'v' },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	int pages_per_step = 256, opt;
+	bool verify = false;
+	const bool show_progress = isatty(STDERR_FILENO);
+	std::string dest;
+
+	while((opt = getopt_long(argc, argv, "p:", long_opts, nullptr)) not_eq -1) {
+		switch(opt) {
+		case 'p':
+			pages_per_step = std::stoi(optarg);
+			if(pages_per_step <= 0) {
+				std::cerr << "Pages per step must be positive." << std::endl;
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'v':
+			verify = true;
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(optind not_eq argc - 1) {
+		std::cerr << "Invalid number of arguments. Use 'help' subcommand for more information." << std::endl;
+		return EXIT_FAILURE;
+	}
+	dest = argv[optind];
+
+	db.open();
+	db.backup(dest, pages_per_step, [show_progress](const int remaining, const int total) {
+			  if(show_progress and total > 0)
+				  std::cerr << std::format("\rBacking up... {:3}% ({}/{} pages)",
+										   100 * (total - remaining) / total, total - remaining, total) << std::flush;
+			  });
+	if(show_progress)
+		std::cerr << std::endl;
+	db.close();
+
+	if(verify) {
+		const std::vector<std::string> problems = db::check_integrity(dest);
+
+		for(const auto &problem : problems)
+			std::cerr << problem << std::endl;
+		if(not problems.empty()) {
+			std::cerr << "Backup " << dest << " failed the integrity check." << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::cout << "Backup " << dest << " passed the integrity check." << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Quote a string as a JSON string.
+ */
+static std::string json_string(const std::string_view str) {
+	std::string quoted = "\"";
+
+	for(const char c : str) {
+		switch(c) {
+		case '"': quoted += "\\\""; break;
+		case '\\': quoted += "\\\\"; break;
+		case '\n': quoted += "\\n"; break;
+		case '\t': quoted += "\\t"; break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20)
+				quoted += std::format("\\u{:04x}", c);
+			else
+				quoted += c;
+			break;
+		}
+	}
+
+	return quoted + "\"";
+}
+
+int cmd_export(int argc, char *argv[]) {
+	db db;
+	const struct option long_opts[] = {
+		{ "since", required_argument, nullptr, 's' },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	std::vector<int> changed, deleted;
+	int since = 0, last_seq, opt;
+
+	while((opt = getopt_long(argc, argv, "s:", long_opts, nullptr)) not_eq -1) {
+		switch(opt) {
+		case 's':
+			since = std::stoi(optarg);
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	db.open();
+
+	last_seq = db.get_changes(since, changed, deleted);
+
+	/*
+	 * Recipes are read after the changes, so they may include later ones,
+	 * which are then exported again next time.
+	 */
+	for(const int id : changed) {
+		const struct recipe recipe = db.get_recipe(id);
+		std::string ingredients, tags;
+
+		for(const auto &ingredient : db.get_recipe_ingredient_amounts(id)) {
+			ingredients += ingredients.empty() ? "" : ",";
+			ingredients += "{\"name\":" + json_string(ingredient.name);
+			if(ingredient.quantity not_eq 0)
+				ingredients += std::format(",\"quantity\":{:g}", ingredient.quantity);
+			if(not ingredient.unit.empty())
+				ingredients += ",\"unit\":" + json_string(ingredient.unit);
+			ingredients += "}";
+		}
+		for(const auto &tag : db.get_recipe_tags(id)) {
+			tags += tags.empty() ? "" : ",";
+			tags += json_string(tag);
+		}
+
+		std::cout << std::format("{{\"op\":\"upsert\",\"id\":{},\"name\":{},\"description\":{},\"ingredients\":[{}],\"tags\":[{}]}}\n",
+								 id, json_string(recipe.name), json_string(recipe.description), ingredients, tags);
+	}
+	for(const int id : deleted)
+		std::cout << std::format("{{\"op\":\"delete\",\"id\":{}}}\n", id);
+
+	std::cout << std::format("{{\"seq\":{}}}", last_seq) << std::endl;
+
+	db.close();
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Copy of a recipe to be stored in another database, overwriting the recipe
+ * with replace_id there if any.
+ */
+static struct recipe_import get_recipe_import(db &db, const struct recipe_hash &hash, const int replace_id) {
+	const struct recipe recipe = db.get_recipe(hash.id);
+	const name_set tags = db.get_recipe_tags(hash.id);
+
+	return { recipe.name, recipe.description, db.get_recipe_ingredient_amounts(hash.id),
+		std::vector<std::string>(tags.begin(), tags.end()), hash.modified, replace_id };
+}
+
+int cmd_sync(const char *path) {
+	db local, other;
+	std::vector<struct recipe_hash> local_hashes, other_hashes;
+	std::vector<struct merkle_leaf> local_leaves, other_leaves;
+	std::vector<struct recipe_import> to_local, to_other;
+	std::unordered_map<std::string, int> ingredient_ids, tag_ids;
+	size_t compared, conflicts = 0;
+
+	local.open();
+	other.open(path);
+
+	local_hashes = local.get_recipe_hashes();
+	other_hashes = other.get_recipe_hashes();
+
+	/*
+	 * Names are unique ignoring case in neither database, but a recipe is
+	 * identified by its lower-cased name: recipes sharing it can't be paired,
+	 * so they are left out of the sync altogether.
+	 */
+	std::set<uint64_t> clashes;
+	auto find_clashes = [&](db &db, const std::vector<struct recipe_hash> &hashes, const std::string &where) {
+		for(size_t i = 1; i < hashes.size(); ++i) {
+			if(hashes[i - 1].key == hashes[i].key and clashes.insert(hashes[i].key).second) {
+				std::cerr << std::format("Skipping recipe '{}': {} has more than one by that name, ignoring case.",
+										 db.get_recipe(hashes[i].id).name, where) << std::endl;
+			}
+		}
+	};
+	find_clashes(local, local_hashes, "this database");
+	find_clashes(other, other_hashes, path);
+	for(auto *hashes : { &local_hashes, &other_hashes })
+		std::erase_if(*hashes, [&](const struct recipe_hash &hash) { return clashes.contains(hash.key); });
+
+	for(const auto &hash : local_hashes)
+		local_leaves.push_back({ hash.key, hash.hash });
+	for(const auto &hash : other_hashes)
+		other_leaves.push_back({ hash.key, hash.hash });
+
+	auto find_key = [](const std::vector<struct recipe_hash> &hashes, const uint64_t key) {
+		const auto it = std::lower_bound(hashes.begin(), hashes.end(), key,
+										 [](const struct recipe_hash &hash, const uint64_t key) { return hash.key < key; });
+		return it not_eq hashes.end() and it->key == key ? &*it : nullptr;
+	};
+
+	/*
+	 * Recipes missing from either side are copied to it. When both have
+	 * changed, the most recently modified version wins, and if both were
+	 * modified at the same time, the one with the greatest hash (so that the
+	 * outcome doesn't depend on which side runs the sync).
+	 */
+	for(const uint64_t key : merkle_diff(local_leaves, other_leaves, compared)) {
+		const struct recipe_hash *local_hash = find_key(local_hashes, key),
+			  *other_hash = find_key(other_hashes, key);
+
+		if(not other_hash) {
+			to_other.push_back(get_recipe_import(local, *local_hash, 0));
+		} else if(not local_hash) {
+			to_local.push_back(get_recipe_import(other, *other_hash, 0));
+		} else {
+			++conflicts;
+			if(std::tie(local_hash->modified, local_hash->hash) > std::tie(other_hash->modified, other_hash->hash))
+				to_other.push_back(get_recipe_import(local, *local_hash, other_hash->id));
+			else
+				to_local.push_back(get_recipe_import(other, *other_hash, local_hash->id));
+		}
+	}
+
+	if(not to_local.empty())
+		local.import_recipes(to_local, ingredient_ids, tag_ids);
+	ingredient_ids.clear();
+	tag_ids.clear();
+	if(not to_other.empty())
+		other.import_recipes(to_other, ingredient_ids, tag_ids);
+
+	local.close();
+	other.close();
+
+	std::cout << std::format("Compared {} hashes of {} and {} recipes: received {} recipes, sent {} ({} differed on both sides).",
+							 compared, local_hashes.size(), other_hashes.size(), to_local.size(), to_other.size(), conflicts)
+		<< std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_stats(int argc, char *argv[]) {
+	db db;
+	struct catalog_stats stats;
+	std::vector<struct name_count> top_ingredients, top_tags;
+	const int name_col_sz = 24, bar_sz = 40;
+	int opt, count = 10, most = 0;
+
+	while((opt = getopt(argc, argv, "n:")) not_eq -1) {
+		switch(opt) {
+		case 'n':
+			count = std::stoi(optarg);
+			break;
+		case '?':
+			std::cerr << "Unknown option '" << static_cast<char>(optopt)
+				<< "'. Use 'help' for information." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	db.open();
+
+	stats = db.get_catalog_stats();
+	top_ingredients = db.get_top_names(NAMES_INGREDIENTS, count);
+	top_tags = db.get_top_names(NAMES_TAGS, count);
+
+	db.close();
+
+	std::cout << "Recipes: " << stats.recipes
+		<< " (" << (stats.sizes.contains(0) ? stats.sizes.at(0) : 0) << " without ingredients)" << std::endl
+		<< "Ingredients: " << stats.ingredients << " (" << stats.unused_ingredients << " unused)" << std::endl
+		<< "Tags: " << stats.tags << " (" << stats.unused_tags << " unused)" << std::endl;
+
+	for(const auto &[title, top] : { std::make_pair("Top ingredients:", &top_ingredients),
+									 std::make_pair("Top tags:", &top_tags) }) {
+		std::cout << std::endl << title << std::endl;
+		for(const auto &name : *top) {
+			std::cout << "\t" << std::left << std::setw(name_col_sz) << name.name
+				<< name.recipes << std::endl;
+		}
+	}
+
+	std::cout << std::endl << "Ingredients per recipe:" << std::endl;
+	for(const auto &[size, recipes] : stats.sizes)
+		most = std::max(most, recipes);
+	for(const auto &[size, recipes] : stats.sizes) {
+		std::cout << "\t" << std::right << std::setw(3) << size << " "
+			<< std::setw(7) << recipes << " "
+			<< std::string(std::max(1, recipes * bar_sz / most), '#') << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int cmd_browse(void) {
+	db db;
+	recipe_set recipes;
+	std::map<std::string, std::vector<int>> ingredients, tags;
+	int picked;
+
+	db.open();
+
+	// everything is read up front, narrowing down happens in memory
+	recipes = db.get_recipes({}, {});
+	ingredients = db.get_recipes_by_name(NAMES_INGREDIENTS);
+	tags = db.get_recipes_by_name(NAMES_TAGS);
+
+	db.close();
+
+	if(recipes.empty()) {
+		std::cerr << "No recipes to browse." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	browser browser(recipes, ingredients, tags);
+	if((picked = browser.run()) >= 0)
+		std::cout << recipes[picked].id << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -19,11 +19,35 @@
 
 int cmd_add(void);
 int cmd_list(int argc, char *argv[]);
+int cmd_similar(int argc, char *argv[]);
+int cmd_suggest(int argc, char *argv[]);
+int cmd_cooked(const int id);
+int cmd_shopping_list(int argc, char *argv[]);
+int cmd_set_nutrition(const char *ingredient, const char *amount, const char *values);
+int cmd_nutrition(int argc, char *argv[]);
+int cmd_dedupe(int argc, char *argv[]);
 int cmd_delete(int argc, char *argv[]);
-int cmd_info(const int id);
+int cmd_info(int argc, char *argv[]);
 int cmd_edit_name(const int id);
 int cmd_edit_desc(const int id);
-int cmd_add_ingr(const int recipe_id, const char *ingredients);
-int cmd_rm_ingr(const int recipe_id, const char *ingredients);
-int cmd_add_tag(const int recipe_id, const char *tags);
-int cmd_rm_tag(const int recipe_id, const char *tags);
+int cmd_add_ingr(int argc, char *argv[]);
+int cmd_rm_ingr(int argc, char *argv[]);
+int cmd_add_tag(int argc, char *argv[]);
+int cmd_rm_tag(int argc, char *argv[]);
+int cmd_merge_ingr(const char *ingredients, const char *into);
+int cmd_merge_tag(const char *tags, const char *into);
+int cmd_move_tag(const char *tag, const char *parent);
+int cmd_tags(void);
+int cmd_rename_ingr(const char *name, const char *new_name);
+int cmd_add_sub(const char *ingredient, const char *substitutes, const char *weight);
+int cmd_rm_sub(const char *ingredient, const char *substitutes);
+int cmd_subs(const char *ingredient);
+int cmd_attach(const int recipe_id, const char *path);
+int cmd_attachment(const int recipe_id, const char *name);
+int cmd_complete(const char *kind, const char *prefix);
+int cmd_ingest(const char *dir);
+int cmd_backup(int argc, char *argv[]);
+int cmd_export(int argc, char *argv[]);
+int cmd_sync(const char *path);
+int cmd_stats(int argc, char *argv[]);
+int cmd_browse(void);
@@ -16,30 +16,243 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "db.hpp"
-
+#include "merkle.hpp"
+#include "minhash.hpp"
+#include "nutrition.hpp"
+#include "prefix_index.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <filesystem>
 #include <format>
+#include <iterator>
+#include <istream>
 #include <iostream>
+#include <map>
+#include <unordered_map>
+#include <ostream>
+#include <set>
 #include <sqlite3.h>
 #include <stdexcept>
+#include <tuple>
+#include <type_traits>
 
-#define DB_VERSION 1
+/*
+ * Statements to upgrade the database from one version to the next, where
+ * upgrade_stmts[n] takes a database from version n+1 to version n+2.
+ */
+static const char *upgrade_stmts[] = {
+	// 1 -> 2
+	"CREATE TABLE attachments(id INTEGER PRIMARY KEY AUTOINCREMENT, recipe_id INTEGER REFERENCES recipes(id) ON DELETE CASCADE, name STRING NOT NULL, size INTEGER NOT NULL, data BLOB, UNIQUE(recipe_id, name));",
+	// 2 -> 3
+	"CREATE TABLE recipe_minhash(recipe_id INTEGER PRIMARY KEY REFERENCES recipes(id) ON DELETE CASCADE, signature BLOB NOT NULL);"
+	"CREATE TABLE recipe_lsh(band INTEGER NOT NULL, bucket INTEGER NOT NULL, recipe_id INTEGER NOT NULL REFERENCES recipes(id) ON DELETE CASCADE, PRIMARY KEY(band, bucket, recipe_id)) WITHOUT ROWID;"
+	"CREATE INDEX recipe_lsh_recipe ON recipe_lsh(recipe_id);",
+	// 3 -> 4
+	"CREATE TABLE history(id INTEGER PRIMARY KEY AUTOINCREMENT, recipe_id INTEGER REFERENCES recipes(id) ON DELETE CASCADE, cooked_at INTEGER NOT NULL);"
+	"CREATE INDEX history_cooked_at ON history(cooked_at);"
+	"CREATE INDEX history_recipe ON history(recipe_id, cooked_at);"
+	"CREATE TABLE recipe_score(recipe_id INTEGER PRIMARY KEY REFERENCES recipes(id) ON DELETE CASCADE, score REAL NOT NULL, updated_at INTEGER NOT NULL);",
+	// 4 -> 5
+	"ALTER TABLE recipe_ingredient ADD COLUMN quantity REAL;"
+	"ALTER TABLE recipe_ingredient ADD COLUMN unit STRING;"
+	"CREATE TABLE units(name STRING PRIMARY KEY, base STRING NOT NULL, factor REAL NOT NULL);"
+	"INSERT INTO units(name,base,factor) VALUES"
+		"('mg','g',0.001),('g','g',1),('gram','g',1),('grams','g',1),('kg','g',1000),"
+		"('oz','g',28.3495),('lb','g',453.592),('lbs','g',453.592),"
+		"('ml','ml',1),('cl','ml',10),('dl','ml',100),('l','ml',1000),"
+		"('tsp','ml',4.92892),('tbsp','ml',14.7868),('cup','ml',236.588),('cups','ml',236.588);",
+	// 5 -> 6
+	"CREATE INDEX recipe_ingredient_ingredient ON recipe_ingredient(ingredient_id);"
+	"CREATE TABLE ingredient_nutrition(ingredient_id INTEGER PRIMARY KEY REFERENCES ingredients(id) ON DELETE CASCADE, unit STRING NOT NULL, nutrients BLOB NOT NULL);"
+	"CREATE TABLE recipe_nutrition(recipe_id INTEGER PRIMARY KEY REFERENCES recipes(id) ON DELETE CASCADE, kcal REAL NOT NULL, nutrients BLOB NOT NULL);"
+	"CREATE INDEX recipe_nutrition_kcal ON recipe_nutrition(kcal);"
+	"CREATE TRIGGER recipe_ingredient_insert_nutrition AFTER INSERT ON recipe_ingredient BEGIN "
+		"DELETE FROM recipe_nutrition WHERE recipe_id=NEW.recipe_id; END;"
+	"CREATE TRIGGER recipe_ingredient_update_nutrition AFTER UPDATE ON recipe_ingredient BEGIN "
+		"DELETE FROM recipe_nutrition WHERE recipe_id IN (OLD.recipe_id, NEW.recipe_id); END;"
+	"CREATE TRIGGER recipe_ingredient_delete_nutrition AFTER DELETE ON recipe_ingredient BEGIN "
+		"DELETE FROM recipe_nutrition WHERE recipe_id=OLD.recipe_id; END;"
+	"CREATE TRIGGER ingredient_nutrition_insert AFTER INSERT ON ingredient_nutrition BEGIN "
+		"DELETE FROM recipe_nutrition WHERE recipe_id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id=NEW.ingredient_id); END;"
+	"CREATE TRIGGER ingredient_nutrition_update AFTER UPDATE ON ingredient_nutrition BEGIN "
+		"DELETE FROM recipe_nutrition WHERE recipe_id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id IN (OLD.ingredient_id, NEW.ingredient_id)); END;"
+	"CREATE TRIGGER ingredient_nutrition_delete AFTER DELETE ON ingredient_nutrition BEGIN "
+		"DELETE FROM recipe_nutrition WHERE recipe_id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id=OLD.ingredient_id); END;",
+	// 6 -> 7
+	"CREATE TABLE substitutes(ingredient_id INTEGER NOT NULL REFERENCES ingredients(id) ON DELETE CASCADE, substitute_id INTEGER NOT NULL REFERENCES ingredients(id) ON DELETE CASCADE, weight REAL NOT NULL DEFAULT 1, PRIMARY KEY(ingredient_id, substitute_id)) WITHOUT ROWID;"
+	"CREATE TABLE substitute_closure(ingredient_id INTEGER NOT NULL REFERENCES ingredients(id) ON DELETE CASCADE, substitute_id INTEGER NOT NULL REFERENCES ingredients(id) ON DELETE CASCADE, PRIMARY KEY(ingredient_id, substitute_id)) WITHOUT ROWID;"
+	"CREATE INDEX substitute_closure_substitute ON substitute_closure(substitute_id);",
+	// 7 -> 8
+	"CREATE TABLE changelog(seq INTEGER PRIMARY KEY AUTOINCREMENT, op STRING NOT NULL, recipe_id INTEGER, item_id INTEGER);"
+	// recipes already there count as added, so that a full export is one since 0
+	"INSERT INTO changelog(op,recipe_id) SELECT 'insert',id FROM recipes;"
+	"CREATE TRIGGER changelog_recipe_insert AFTER INSERT ON recipes BEGIN INSERT INTO changelog(op,recipe_id) VALUES('insert',new.id); END;"
+	"CREATE TRIGGER changelog_recipe_update AFTER UPDATE OF name,description ON recipes BEGIN INSERT INTO changelog(op,recipe_id) VALUES('update',new.id); END;"
+	"CREATE TRIGGER changelog_recipe_delete AFTER DELETE ON recipes BEGIN INSERT INTO changelog(op,recipe_id) VALUES('delete',old.id); END;"
+	"CREATE TRIGGER changelog_ingredient_link AFTER INSERT ON recipe_ingredient BEGIN INSERT INTO changelog(op,recipe_id,item_id) VALUES('link_ingredient',new.recipe_id,new.ingredient_id); END;"
+	"CREATE TRIGGER changelog_ingredient_amount AFTER UPDATE OF quantity,unit ON recipe_ingredient BEGIN INSERT INTO changelog(op,recipe_id,item_id) VALUES('update_ingredient',new.recipe_id,new.ingredient_id); END;"
+	"CREATE TRIGGER changelog_ingredient_unlink AFTER DELETE ON recipe_ingredient BEGIN INSERT INTO changelog(op,recipe_id,item_id) VALUES('unlink_ingredient',old.recipe_id,old.ingredient_id); END;"
+	"CREATE TRIGGER changelog_tag_link AFTER INSERT ON recipe_tag BEGIN INSERT INTO changelog(op,recipe_id,item_id) VALUES('link_tag',new.recipe_id,new.tag_id); END;"
+	"CREATE TRIGGER changelog_tag_unlink AFTER DELETE ON recipe_tag BEGIN INSERT INTO changelog(op,recipe_id,item_id) VALUES('unlink_tag',old.recipe_id,old.tag_id); END;"
+	// renaming changes every recipe with the ingredient or tag
+	"CREATE TRIGGER changelog_ingredient_rename AFTER UPDATE OF name ON ingredients BEGIN INSERT INTO changelog(op,item_id) VALUES('rename_ingredient',new.id); END;"
+	"CREATE TRIGGER changelog_tag_rename AFTER UPDATE OF name ON tags BEGIN INSERT INTO changelog(op,item_id) VALUES('rename_tag',new.id); END;",
+	// 8 -> 9
+	// hashes are computed on demand, triggers only clear them and bump the time of modification
+	"CREATE TABLE recipe_hash(recipe_id INTEGER PRIMARY KEY REFERENCES recipes(id) ON DELETE CASCADE, hash INTEGER, modified INTEGER NOT NULL);"
+	"INSERT INTO recipe_hash(recipe_id,modified) SELECT id,strftime('%s','now') FROM recipes;"
+	"CREATE TRIGGER recipe_hash_insert AFTER INSERT ON recipes BEGIN "
+		"INSERT INTO recipe_hash(recipe_id,modified) VALUES(NEW.id,strftime('%s','now')); END;"
+	"CREATE TRIGGER recipe_hash_update AFTER UPDATE OF name,description ON recipes BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id=NEW.id; END;"
+	"CREATE TRIGGER recipe_ingredient_insert_hash AFTER INSERT ON recipe_ingredient BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id=NEW.recipe_id; END;"
+	"CREATE TRIGGER recipe_ingredient_update_hash AFTER UPDATE ON recipe_ingredient BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id IN (OLD.recipe_id, NEW.recipe_id); END;"
+	"CREATE TRIGGER recipe_ingredient_delete_hash AFTER DELETE ON recipe_ingredient BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id=OLD.recipe_id; END;"
+	"CREATE TRIGGER recipe_tag_insert_hash AFTER INSERT ON recipe_tag BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id=NEW.recipe_id; END;"
+	"CREATE TRIGGER recipe_tag_delete_hash AFTER DELETE ON recipe_tag BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id=OLD.recipe_id; END;"
+	"CREATE TRIGGER ingredient_rename_hash AFTER UPDATE OF name ON ingredients BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id=NEW.id); END;"
+	"CREATE TRIGGER tag_rename_hash AFTER UPDATE OF name ON tags BEGIN "
+		"UPDATE recipe_hash SET hash=NULL,modified=strftime('%s','now') WHERE recipe_id IN (SELECT recipe_id FROM recipe_tag WHERE tag_id=NEW.id); END;",
+	// 9 -> 10
+	// counters kept exact by triggers, so that statistics never need to scan the link tables
+	"CREATE TABLE ingredient_stats(ingredient_id INTEGER PRIMARY KEY REFERENCES ingredients(id) ON DELETE CASCADE, recipes INTEGER NOT NULL);"
+	"CREATE INDEX ingredient_stats_recipes ON ingredient_stats(recipes);"
+	"CREATE TABLE tag_stats(tag_id INTEGER PRIMARY KEY REFERENCES tags(id) ON DELETE CASCADE, recipes INTEGER NOT NULL);"
+	"CREATE INDEX tag_stats_recipes ON tag_stats(recipes);"
+	"CREATE TABLE recipe_size(recipe_id INTEGER PRIMARY KEY REFERENCES recipes(id) ON DELETE CASCADE, ingredients INTEGER NOT NULL);"
+	// number of recipes with each number of ingredients
+	"CREATE TABLE recipe_size_histogram(ingredients INTEGER PRIMARY KEY, recipes INTEGER NOT NULL);"
+	"INSERT INTO ingredient_stats SELECT id,(SELECT count(*) FROM recipe_ingredient WHERE ingredient_id=ingredients.id) FROM ingredients;"
+	"INSERT INTO tag_stats SELECT id,(SELECT count(*) FROM recipe_tag WHERE tag_id=tags.id) FROM tags;"
+	"INSERT INTO recipe_size SELECT id,(SELECT count(*) FROM recipe_ingredient WHERE recipe_id=recipes.id) FROM recipes;"
+	"INSERT INTO recipe_size_histogram SELECT ingredients,count(*) FROM recipe_size GROUP BY ingredients;"
+	"CREATE TRIGGER ingredient_stats_insert AFTER INSERT ON ingredients BEGIN "
+		"INSERT INTO ingredient_stats VALUES(NEW.id,0); END;"
+	"CREATE TRIGGER tag_stats_insert AFTER INSERT ON tags BEGIN "
+		"INSERT INTO tag_stats VALUES(NEW.id,0); END;"
+	"CREATE TRIGGER recipe_size_insert AFTER INSERT ON recipes BEGIN "
+		"INSERT INTO recipe_size VALUES(NEW.id,0); END;"
+	"CREATE TRIGGER recipe_ingredient_insert_stats AFTER INSERT ON recipe_ingredient BEGIN "
+		"UPDATE ingredient_stats SET recipes=recipes+1 WHERE ingredient_id=NEW.ingredient_id;"
+		"UPDATE recipe_size SET ingredients=ingredients+1 WHERE recipe_id=NEW.recipe_id; END;"
+	"CREATE TRIGGER recipe_ingredient_update_stats AFTER UPDATE OF recipe_id,ingredient_id ON recipe_ingredient BEGIN "
+		"UPDATE ingredient_stats SET recipes=recipes-1 WHERE ingredient_id=OLD.ingredient_id;"
+		"UPDATE recipe_size SET ingredients=ingredients-1 WHERE recipe_id=OLD.recipe_id;"
+		"UPDATE ingredient_stats SET recipes=recipes+1 WHERE ingredient_id=NEW.ingredient_id;"
+		"UPDATE recipe_size SET ingredients=ingredients+1 WHERE recipe_id=NEW.recipe_id; END;"
+	"CREATE TRIGGER recipe_ingredient_delete_stats AFTER DELETE ON recipe_ingredient BEGIN "
+		"UPDATE ingredient_stats SET recipes=recipes-1 WHERE ingredient_id=OLD.ingredient_id;"
+		"UPDATE recipe_size SET ingredients=ingredients-1 WHERE recipe_id=OLD.recipe_id; END;"
+	"CREATE TRIGGER recipe_tag_insert_stats AFTER INSERT ON recipe_tag BEGIN "
+		"UPDATE tag_stats SET recipes=recipes+1 WHERE tag_id=NEW.tag_id; END;"
+	"CREATE TRIGGER recipe_tag_delete_stats AFTER DELETE ON recipe_tag BEGIN "
+		"UPDATE tag_stats SET recipes=recipes-1 WHERE tag_id=OLD.tag_id; END;"
+	"CREATE TRIGGER recipe_size_insert_histogram AFTER INSERT ON recipe_size BEGIN "
+		"INSERT OR IGNORE INTO recipe_size_histogram VALUES(NEW.ingredients,0);"
+		"UPDATE recipe_size_histogram SET recipes=recipes+1 WHERE ingredients=NEW.ingredients; END;"
+	"CREATE TRIGGER recipe_size_update_histogram AFTER UPDATE OF ingredients ON recipe_size BEGIN "
+		"UPDATE recipe_size_histogram SET recipes=recipes-1 WHERE ingredients=OLD.ingredients;"
+		"INSERT OR IGNORE INTO recipe_size_histogram VALUES(NEW.ingredients,0);"
+		"UPDATE recipe_size_histogram SET recipes=recipes+1 WHERE ingredients=NEW.ingredients; END;"
+	"CREATE TRIGGER recipe_size_delete_histogram AFTER DELETE ON recipe_size BEGIN "
+		"UPDATE recipe_size_histogram SET recipes=recipes-1 WHERE ingredients=OLD.ingredients; END;",
+	// 10 -> 11
+	"ALTER TABLE tags ADD COLUMN parent_id INTEGER REFERENCES tags(id) ON DELETE SET NULL;"
+	"CREATE INDEX tags_parent ON tags(parent_id);"
+	"CREATE INDEX recipe_tag_tag ON recipe_tag(tag_id);"
+	// every ancestor of every tag, the tag itself included (at depth 0)
+	"CREATE TABLE tag_closure(ancestor_id INTEGER NOT NULL REFERENCES tags(id) ON DELETE CASCADE, descendant_id INTEGER NOT NULL REFERENCES tags(id) ON DELETE CASCADE, depth INTEGER NOT NULL, PRIMARY KEY(ancestor_id, descendant_id)) WITHOUT ROWID;"
+	"CREATE INDEX tag_closure_descendant ON tag_closure(descendant_id);"
+	"INSERT INTO tag_closure SELECT id,id,0 FROM tags;"
+	"CREATE TRIGGER tag_closure_insert AFTER INSERT ON tags BEGIN "
+		"INSERT INTO tag_closure VALUES(NEW.id,NEW.id,0);"
+		"INSERT INTO tag_closure SELECT ancestor_id,NEW.id,depth+1 FROM tag_closure WHERE descendant_id=NEW.parent_id; END;"
+	"CREATE TRIGGER tag_parent_check BEFORE UPDATE OF parent_id ON tags "
+		"WHEN NEW.parent_id IN (SELECT descendant_id FROM tag_closure WHERE ancestor_id=NEW.id) BEGIN "
+		"SELECT RAISE(ABORT,'a tag cannot be placed under itself or its descendants'); END;"
+	// moving a tag detaches its subtree from its former ancestors and attaches it to the new ones
+	"CREATE TRIGGER tag_closure_move AFTER UPDATE OF parent_id ON tags BEGIN "
+		"DELETE FROM tag_closure WHERE descendant_id IN (SELECT descendant_id FROM tag_closure WHERE ancestor_id=NEW.id) "
+			"AND ancestor_id NOT IN (SELECT descendant_id FROM tag_closure WHERE ancestor_id=NEW.id);"
+		"INSERT INTO tag_closure SELECT a.ancestor_id,d.descendant_id,a.depth+d.depth+1 FROM tag_closure AS a, tag_closure AS d "
+			"WHERE a.descendant_id=NEW.parent_id AND d.ancestor_id=NEW.id; END;",
+	// 11 -> 12
+	// recipe hashes now take tag names lower-cased, as other databases may spell them differently
+	"UPDATE recipe_hash SET hash=NULL;",
+	// 12 -> 13
+	// without knowing how many ingredients were counted, a recipe without any looked like 0 kcal
+	"ALTER TABLE recipe_nutrition ADD COLUMN counted INTEGER NOT NULL DEFAULT 0;"
+	"ALTER TABLE recipe_nutrition ADD COLUMN ingredients INTEGER NOT NULL DEFAULT 0;"
+	"DELETE FROM recipe_nutrition;",
+};
+
+#define DB_VERSION (1 + static_cast<int>(sizeof(upgrade_stmts) / sizeof(*upgrade_stmts)))
+/*
+ * Time it takes for a meal to count half as much towards its recipe's cooking
+ * score, in seconds.
+ */
+#define SCORE_HALF_LIFE (14 * 24 * 60 * 60)
+// size of the buffer used to stream attachments in and out of the database
+#define BLOB_CHUNK_SZ 65536
+// time given to other connections between steps of a backup, in milliseconds
+#define BACKUP_STEP_PAUSE 10
+// file the query cache of the default database is kept in, within the data directory
+#define QUERY_CACHE_FILE "query.cache"
+// position of the change counter in the header of a database file
+#define DB_CHANGE_COUNTER_OFFSET 24
 
-void db::open(void) {
-	std::string xdg_data_home;
-	std::string db_path;
-	bool new_db = false;
+/*
+ * Comma-separated list of IDs, to be used within an SQL "IN (...)" clause.
+ */
+static std::string join_ids(const std::vector<int> &ids) {
+	std::string list;
+
+	for(auto id : ids) {
+		if(not list.empty())
+			list += ",";
+		list += std::to_string(id);
+	}
+
+	return list;
+}
+
+/*
+ * Directory holding the database and its companion files, created if needed.
+ */
+static std::string get_data_dir(void) {
+	const char *xdg_data_home = std::getenv("XDG_DATA_HOME");
+	std::string data_dir;
 
-	if((xdg_data_home = std::getenv("XDG_DATA_HOME")).empty())
+	if(not xdg_data_home or not *xdg_data_home)
 		throw std::runtime_error("Cannot find environment variable XDG_DATA_HOME. Please define it before continuing.");
 
-	db_path = xdg_data_home + "/menu-helper";
+	data_dir = std::string(xdg_data_home) + "/menu-helper";
+
+	if(not std::filesystem::exists(data_dir))
+		std::filesystem::create_directories(data_dir);
+
+	return data_dir;
+}
+
+void db::open(void) {
+	open(get_data_dir() + "/recipes.db");
+	// only the default database has completion indexes
+	default_db = true;
+}
 
-	if(not std::filesystem::exists(db_path))
-		std::filesystem::create_directories(db_path);
+void db::open(const std::string &db_path) {
+	bool new_db = false;
 
-	db_path += "/recipes.db";
+	default_db = false;
 
 	if(not std::filesystem::exists(db_path)) {
 		std::cout << "Creating database in " << db_path << std::endl;
@@ -49,25 +262,121 @@ void db::open(void) {
 	if(sqlite3_open(db_path.c_str(), &sqlite_db) not_eq SQLITE_OK)
 		throw std::runtime_error("Failed to open database file " + db_path);
 
+	// needed for the ON DELETE CASCADE clauses to take effect
+	sqlite3_exec(sqlite_db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+
 	if(new_db) {
 		sqlite3_exec(sqlite_db, "CREATE TABLE db_version(version INTEGER UNIQUE NOT NULL);", nullptr, nullptr, nullptr);
-		sqlite3_exec(sqlite_db, std::format("INSERT INTO db_version VALUES({});", DB_VERSION).c_str(), nullptr, nullptr, nullptr);
+		sqlite3_exec(sqlite_db, "INSERT INTO db_version VALUES(1);", nullptr, nullptr, nullptr);
 		sqlite3_exec(sqlite_db, "CREATE TABLE tags(id INTEGER PRIMARY KEY AUTOINCREMENT, name STRING UNIQUE);", nullptr, nullptr, nullptr);
 		sqlite3_exec(sqlite_db, "CREATE TABLE ingredients(id INTEGER PRIMARY KEY AUTOINCREMENT, name STRING UNIQUE);", nullptr, nullptr, nullptr);
 		sqlite3_exec(sqlite_db, "CREATE TABLE recipes(id INTEGER PRIMARY KEY AUTOINCREMENT, name STRING UNIQUE, description STRING);", nullptr, nullptr, nullptr);
 		sqlite3_exec(sqlite_db, "CREATE TABLE recipe_tag(recipe_id INTEGER REFERENCES recipes(id) ON DELETE CASCADE, tag_id INTEGER REFERENCES tags(id) ON DELETE CASCADE, UNIQUE(recipe_id, tag_id));", nullptr, nullptr, nullptr);
 		sqlite3_exec(sqlite_db, "CREATE TABLE recipe_ingredient(recipe_id INTEGER REFERENCES recipes(id) ON DELETE CASCADE, ingredient_id INTEGER REFERENCES ingredients(id) ON DELETE CASCADE, UNIQUE(recipe_id, ingredient_id));", nullptr, nullptr, nullptr);
 	}
+
+	upgrade();
+}
+
+void db::open_read_only(const std::string &path) {
+	if(sqlite3_open_v2(path.c_str(), &sqlite_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) not_eq SQLITE_OK) {
+		sqlite3_close(sqlite_db);
+		sqlite_db = nullptr;
+		throw std::runtime_error("Failed to open database file " + path);
+	}
+
+	// without write access an old database can't be upgraded to be queried
+	if(get_db_version() not_eq DB_VERSION) {
+		close();
+		throw std::runtime_error(std::format("Database {} is not at version {}. Open it with write access first.", path, DB_VERSION));
+	}
+}
+
+std::vector<std::string> db::get_search_path(void) {
+	const char *search_path = std::getenv("MENU_HELPER_PATH");
+	std::vector<std::string> paths;
+
+	if(not search_path)
+		return paths;
+
+	for(auto &path : split(search_path, ":")) {
+		if(not path.empty())
+			paths.push_back(path);
+	}
+
+	return paths;
+}
+
+int db::get_db_version(void) {
+	int version = 0;
+
+	if(sqlite3_exec(sqlite_db, "SELECT version FROM db_version;",
+					[](void *version, int, char **col_data, char**) {
+					*static_cast<int*>(version) = std::atoi(col_data[0]);
+					return 0;
+					}, &version, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to get database version.");
+	}
+
+	return version;
+}
+
+void db::upgrade(void) {
+	const int old_version = get_db_version();
+	int version = old_version;
+
+	if(version > DB_VERSION)
+		throw std::runtime_error(std::format("Database version {} is newer than supported version {}.", version, DB_VERSION));
+
+	for(; version < DB_VERSION; ++version) {
+		sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+		if(sqlite3_exec(sqlite_db, upgrade_stmts[version - 1], nullptr, nullptr, nullptr) not_eq SQLITE_OK or
+		   sqlite3_exec(sqlite_db, std::format("UPDATE db_version SET version={};", version + 1).c_str(),
+						nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+			sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw std::runtime_error(std::format("Failed to upgrade database to version {}.", version + 1));
+		}
+		sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+	}
+
+	// signatures can't be computed in SQL, so fill them in for existing recipes
+	if(old_version < 3) {
+		std::vector<int> ids;
+
+		sqlite3_exec(sqlite_db, "SELECT id FROM recipes;",
+					 [](void *ids, int, char **col_data, char**) {
+					 static_cast<std::vector<int>*>(ids)->push_back(std::atoi(col_data[0]));
+					 return 0;
+					 }, &ids, nullptr);
+
+		sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+		for(auto id : ids)
+			update_recipe_minhash(id);
+		sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+	}
 }
 
 void db::close(void) {
 	if(not sqlite_db)
 		return;
 
+	for(int kind = 0; default_db and kind < NAME_KIND_NUM; ++kind) {
+		if(stale_indexes & (1 << kind))
+			rebuild_name_index(static_cast<enum name_kind>(kind));
+	}
+	stale_indexes = 0;
+
+	if(default_db and cache.is_loaded() and not cache.save(get_data_dir() + "/" QUERY_CACHE_FILE))
+		std::cerr << "Failed to update query cache " << get_data_dir() + "/" QUERY_CACHE_FILE << "." << std::endl;
+
 	sqlite3_close(sqlite_db);
 	sqlite_db = nullptr;
 }
 
+int db::get_error_code(void) {
+	return sqlite_db ? sqlite3_errcode(sqlite_db) : SQLITE_MISUSE;
+}
+
 int query_id_cb(void *recipe_id_var, int col_num, char **col_data, char **col_name) {
 	int *recipe_id_ptr = (int*)recipe_id_var;
 	int ret = 1;
@@ -106,6 +415,8 @@ int db::add_recipe(const std::string &name, const std::string &description) {
 		throw std::runtime_error("Failed to insert new recipe into database.");
 	}
 
+	stale_indexes |= INDEX_RECIPES;
+
 	return get_recipe_id(name);
 }
 
@@ -117,6 +428,8 @@ void db::del_recipe(const int id) {
 					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
 		throw std::runtime_error(std::format("Failed to delete recipe with ID {} from database.", id));
 	}
+
+	stale_indexes |= INDEX_RECIPES;
 }
 
 void db::del_recipes(const std::vector<int> &ids) {
@@ -139,6 +452,25 @@ void db::del_recipes(const std::vector<int> &ids) {
 
 	if(sqlite3_exec(sqlite_db, stmt.c_str(), nullptr, nullptr, nullptr) not_eq SQLITE_OK)
 		throw std::runtime_error("Failed to delete recipes from database.");
+
+	stale_indexes |= INDEX_RECIPES;
+}
+
+std::vector<int> db::get_existing_recipe_ids(const std::vector<int> &ids) {
+	std::vector<int> existing;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT id FROM recipes WHERE id IN ({});", join_ids(ids)).c_str(),
+					[](void *existing, int, char **col_data, char**) {
+					static_cast<std::vector<int>*>(existing)->push_back(std::atoi(col_data[0]));
+					return 0;
+					}, &existing, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select from database.");
+	}
+
+	return existing;
 }
 
 bool db::recipe_exists(const int id) {
@@ -183,6 +515,8 @@ void db::update_recipe_name(const int id, const std::string &new_name) {
 					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
 		throw std::runtime_error(std::format("Failed to modify name of recipe with ID {}.", id));
 	}
+
+	stale_indexes |= INDEX_RECIPES;
 }
 
 void db::update_recipe_desc(const int id, const std::string &new_desc) {
@@ -195,70 +529,94 @@ void db::update_recipe_desc(const int id, const std::string &new_desc) {
 	}
 }
 
-std::vector<struct recipe> db::get_recipes(const std::vector<std::string> &ingredients,
-										   const std::vector<std::string> &tags)
+recipe_set db::get_recipes(const std::vector<std::string> &ingredients,
+						   const std::vector<std::string> &tags,
+						   const double max_kcal,
+						   const bool allow_subs)
 {
-	std::vector<struct recipe> recipes;
 	std::string stmt = "SELECT id,name,description FROM recipes";
 	std::string filters;
+	std::vector<int> ingredient_ids, tag_ids;
+	// filters along with the number of recipes they let through
+	std::vector<std::pair<int, std::string>> terms;
 
 	if(not sqlite_db)
 		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
 
-	if(not ingredients.empty() or not tags.empty())
-		filters += " WHERE";
+	for(auto &i : ingredients) {
+		int id;
 
-	if(not ingredients.empty()) {
-		bool first = true;
-		for(auto &i : ingredients) {
-			int id;
-
-			if(first)
-				first = false;
-			else
-				filters += " AND";
-
-			filters += " id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id=";
+		if((id = get_ingredient_id(i)) <= 0)
+			throw std::runtime_error(std::format("Failed to find ingredient '{}'", i));
+		ingredient_ids.push_back(id);
+	}
+	for(auto &i : tags) {
+		int id;
 
-			if((id = get_ingredient_id(i)) <= 0)
-				throw std::runtime_error(std::format("Failed to find ingredient '{}'", i));
+		if((id = get_tag_id(i)) <= 0)
+			throw std::runtime_error(std::format("Failed to find tag '{}'", i));
+		tag_ids.push_back(id);
+	}
 
-			filters += std::to_string(id);
-			filters += ")";
+	std::map<int, int> counts = get_recipe_counts(NAMES_INGREDIENTS, ingredient_ids);
+	for(auto id : ingredient_ids) {
+		// substitutes let more recipes through, but it's still a fair guess
+		if(allow_subs) {
+			terms.emplace_back(counts[id], std::format("id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id IN "
+													   "(SELECT {0} UNION ALL SELECT substitute_id FROM substitute_closure WHERE ingredient_id={0}))", id));
+		} else {
+			terms.emplace_back(counts[id], std::format("id IN (SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id={})", id));
 		}
 	}
 
-	if(not tags.empty()) {
-		if(not filters.empty())
-			filters += " AND";
-
-		bool first = true;
-		for(auto &i : tags) {
-			int id;
-
-			if(first)
-				first = false;
-			else
-				filters += " AND";
+	counts = get_recipe_counts(NAMES_TAGS, tag_ids);
+	for(auto id : tag_ids)
+		terms.emplace_back(counts[id], std::format("id IN (SELECT recipe_id FROM recipe_tag WHERE tag_id IN "
+												   "(SELECT descendant_id FROM tag_closure WHERE ancestor_id={}))", id));
+
+	/*
+	 * SQLite looks recipes up by the first of the terms on their ID, so start
+	 * from the rarest one to go through as few recipes as possible.
+	 */
+	std::stable_sort(terms.begin(), terms.end(), [](const auto &a, const auto &b) {
+					 return a.first < b.first;
+					 });
+
+	if(max_kcal > 0) {
+		// read-only connections make do with what's already cached
+		if(not sqlite3_db_readonly(sqlite_db, "main"))
+			update_nutrition_cache();
+		// only recipes with every ingredient counted have a known total to compare
+		terms.emplace_back(0, std::format("id IN (SELECT recipe_id FROM recipe_nutrition WHERE kcal<={} AND counted=ingredients AND ingredients>0)", max_kcal));
+	}
 
-			filters += " id IN (SELECT recipe_id FROM recipe_tag WHERE tag_id=";
+	for(auto &term : terms) {
+		filters += filters.empty() ? " WHERE " : " AND ";
+		filters += term.second;
+	}
 
-			if((id = get_tag_id(i)) <= 0)
-				throw std::runtime_error("Failed to find tag '{}'");
+	stmt += filters + " ORDER BY id;";
 
-			filters += std::to_string(id);
-			filters += ")";
-		}
+	// unfiltered queries are no quicker from the cache, nor can one be used amid a transaction
+	if(default_db and not terms.empty() and sqlite3_get_autocommit(sqlite_db)) {
+		std::sort(ingredient_ids.begin(), ingredient_ids.end());
+		std::sort(tag_ids.begin(), tag_ids.end());
+		return get_cached_recipes(stmt, std::format("i:{};t:{};k:{:g};s:{:d}", join_ids(ingredient_ids),
+													join_ids(tag_ids), max_kcal, allow_subs));
 	}
 
-	stmt += filters + ";";
+	return select_recipes(stmt);
+}
+
+recipe_set db::select_recipes(const std::string &stmt) {
+	recipe_set recipes;
 
 	if(sqlite3_exec(sqlite_db, stmt.c_str(),
 					[](void *recipe_list, int, char **col_data, char**) {
-					static_cast<std::vector<struct recipe>*>(recipe_list)->push_back({
-																					 std::atoi(col_data[0]),
-																					 col_data[1],
-																					 col_data[2] });
+					recipe_set *recipes = static_cast<recipe_set*>(recipe_list);
+					recipes->push_back({ std::atoi(col_data[0]),
+									   recipes->store(col_data[1]),
+									   recipes->store(col_data[2]) });
 					return 0;
 					}, &recipes, nullptr) not_eq SQLITE_OK) {
 		throw std::runtime_error("Failed to select recipes.");
@@ -267,6 +625,444 @@ std::vector<struct recipe> db::get_recipes(const std::vector<std::string> &ingre
 	return recipes;
 }
 
+recipe_set db::get_cached_recipes(const std::string &stmt, const std::string &key) {
+	const std::vector<int> *ids;
+	recipe_set recipes;
+
+	if(not cache.is_loaded())
+		cache.load(get_data_dir() + "/" QUERY_CACHE_FILE);
+
+	/*
+	 * Read the change counter within the same transaction as the recipes
+	 * (after something else, since that's when the transaction starts), so
+	 * that no change can come in between.
+	 */
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	try {
+		if(sqlite3_exec(sqlite_db, "SELECT version FROM db_version;", nullptr, nullptr, nullptr) not_eq SQLITE_OK)
+			throw std::runtime_error("Failed to start reading recipes.");
+
+		if((ids = cache.lookup(key, get_change_counter()))) {
+			recipes = select_recipes(std::format("SELECT id,name,description FROM recipes WHERE id IN ({}) ORDER BY id;",
+												 join_ids(*ids)));
+		} else {
+			std::vector<int> found;
+
+			recipes = select_recipes(stmt);
+			for(const auto &recipe : recipes)
+				found.push_back(recipe.id);
+			cache.insert(key, found);
+		}
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	return recipes;
+}
+
+uint32_t db::get_change_counter(void) {
+	sqlite3_file *file = nullptr;
+	unsigned char counter[4];
+
+	// through SQLite's own file handle, as closing another one would drop its locks
+	if(sqlite3_file_control(sqlite_db, "main", SQLITE_FCNTL_FILE_POINTER, &file) not_eq SQLITE_OK or
+	   not file or not file->pMethods or
+	   file->pMethods->xRead(file, counter, sizeof(counter), DB_CHANGE_COUNTER_OFFSET) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to read the change counter of the database.");
+	}
+
+	return (static_cast<uint32_t>(counter[0]) << 24) | (counter[1] << 16) | (counter[2] << 8) | counter[3];
+}
+
+std::vector<struct scored_recipe> db::get_similar_recipes(const int id, const int count) {
+	std::vector<struct scored_recipe> similar;
+	std::map<int, std::vector<int>> candidates;
+	minhash_sig sig(MINHASH_SZ);
+	sqlite3_stmt *stmt;
+	std::vector<int> candidate_ids;
+	std::string filter;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_prepare_v2(sqlite_db, "SELECT signature FROM recipe_minhash WHERE recipe_id=?;",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare signature selection.");
+	}
+	sqlite3_bind_int(stmt, 1, id);
+	if(sqlite3_step(stmt) not_eq SQLITE_ROW or
+	   sqlite3_column_bytes(stmt, 0) not_eq MINHASH_SZ * sizeof(uint32_t)) {
+		sqlite3_finalize(stmt);
+		return similar;
+	}
+	std::copy_n(static_cast<const uint32_t*>(sqlite3_column_blob(stmt, 0)), MINHASH_SZ, sig.begin());
+	sqlite3_finalize(stmt);
+
+	for(int band = 0; band < LSH_BANDS; ++band) {
+		if(band > 0)
+			filter += " OR";
+		filter += std::format(" (band={} AND bucket={})", band, lsh_bucket(sig, band));
+	}
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT DISTINCT recipe_id FROM recipe_lsh WHERE recipe_id<>{} AND ({});", id, filter).c_str(),
+					[](void *candidates, int, char **col_data, char**) {
+					(*static_cast<std::map<int, std::vector<int>>*>(candidates))[std::atoi(col_data[0])];
+					return 0;
+					}, &candidates, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to find recipes similar to recipe with ID {}.", id));
+	}
+
+	if(candidates.empty())
+		return similar;
+
+	for(const auto &candidate : candidates)
+		candidate_ids.push_back(candidate.first);
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT recipe_id,ingredient_id FROM recipe_ingredient WHERE recipe_id IN ({}) ORDER BY recipe_id,ingredient_id;", join_ids(candidate_ids)).c_str(),
+					[](void *candidates, int, char **col_data, char**) {
+					(*static_cast<std::map<int, std::vector<int>>*>(candidates))[std::atoi(col_data[0])].push_back(std::atoi(col_data[1]));
+					return 0;
+					}, &candidates, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select ingredients of similar recipes.");
+	}
+
+	const std::vector<int> ingredients = get_recipe_ingredient_ids(id);
+	std::vector<std::pair<double, int>> ranking;
+	for(const auto &candidate : candidates)
+		ranking.push_back({ jaccard(ingredients, candidate.second), candidate.first });
+
+	const size_t top = std::min(ranking.size(), static_cast<size_t>(std::max(count, 0)));
+	std::partial_sort(ranking.begin(), ranking.begin() + top, ranking.end(),
+					  [](const auto &a, const auto &b) {
+					  return a.first > b.first or (a.first == b.first and a.second < b.second);
+					  });
+	ranking.resize(top);
+
+	for(const auto &rank : ranking)
+		similar.push_back({ get_recipe(rank.second), rank.first });
+
+	return similar;
+}
+
+std::map<int, std::vector<int>> db::get_all_recipe_ingredient_ids(void) {
+	std::map<int, std::vector<int>> ingredients;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, "SELECT recipe_id,ingredient_id FROM recipe_ingredient ORDER BY recipe_id,ingredient_id;",
+					[](void *ingredients, int, char **col_data, char**) {
+					(*static_cast<std::map<int, std::vector<int>>*>(ingredients))[std::atoi(col_data[0])].push_back(std::atoi(col_data[1]));
+					return 0;
+					}, &ingredients, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select recipe ingredients.");
+	}
+
+	return ingredients;
+}
+
+std::vector<std::vector<int>> db::get_ingredient_buckets(void) {
+	std::vector<std::vector<int>> buckets;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, "SELECT group_concat(recipe_id) FROM recipe_lsh GROUP BY band,bucket HAVING count(*)>1;",
+					[](void *buckets, int, char **col_data, char**) {
+					std::vector<int> bucket;
+					for(char *i = col_data[0]; *i;) {
+						bucket.push_back(std::strtol(i, &i, 10));
+						if(*i == ',')
+							++i;
+					}
+					static_cast<std::vector<std::vector<int>>*>(buckets)->push_back(std::move(bucket));
+					return 0;
+					}, &buckets, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select LSH buckets.");
+	}
+
+	return buckets;
+}
+
+void db::move_attachments(const int survivor, const std::string &id_list) {
+	std::vector<std::tuple<int, int, std::string>> attachments;
+	std::set<std::string> names;
+	sqlite3_stmt *stmt;
+
+	// the survivor's attachments come first so they keep their names
+	if(sqlite3_exec(sqlite_db, std::format("SELECT id,recipe_id,name FROM attachments WHERE recipe_id IN ({0},{1}) ORDER BY recipe_id<>{0},id;",
+										   survivor, id_list).c_str(),
+					[](void *attachments, int, char **col_data, char**) {
+					static_cast<std::vector<std::tuple<int, int, std::string>>*>(attachments)->push_back({ std::atoi(col_data[0]),
+																										  std::atoi(col_data[1]),
+																										  col_data[2] });
+					return 0;
+					}, &attachments, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select attachments of recipes merged into recipe with ID {}.", survivor));
+	}
+
+	if(sqlite3_prepare_v2(sqlite_db, "UPDATE attachments SET recipe_id=?,name=? WHERE id=?;",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare attachment update.");
+	}
+	for(auto &[id, recipe_id, name] : attachments) {
+		if(recipe_id == survivor) {
+			names.insert(name);
+			continue;
+		}
+
+		// clashing names get the ID of the recipe they came from, e.g. "notes (2).txt"
+		if(names.contains(name)) {
+			const std::filesystem::path path(name);
+			std::string new_name;
+			for(int i = 1; names.contains(new_name = i == 1 ?
+											 std::format("{} ({}){}", path.stem().string(), recipe_id, path.extension().string()) :
+											 std::format("{} ({}-{}){}", path.stem().string(), recipe_id, i, path.extension().string()));
+				++i);
+			name = std::move(new_name);
+		}
+		names.insert(name);
+
+		sqlite3_bind_int(stmt, 1, survivor);
+		sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 3, id);
+		if(sqlite3_step(stmt) not_eq SQLITE_DONE) {
+			sqlite3_finalize(stmt);
+			throw std::runtime_error(std::format("Failed to move attachment '{}' to recipe with ID {}.", name, survivor));
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+}
+
+void db::merge_recipes(const int survivor, const std::vector<int> &ids) {
+	std::vector<int> merged;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	std::copy_if(ids.begin(), ids.end(), std::back_inserter(merged), [=](int id) { return id not_eq survivor; });
+	if(merged.empty())
+		return;
+	const std::string id_list = join_ids(merged);
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, std::format("INSERT OR IGNORE INTO recipe_ingredient(recipe_id,ingredient_id,quantity,unit) SELECT {0},ingredient_id,quantity,unit FROM recipe_ingredient WHERE recipe_id IN ({1});"
+										   "INSERT OR IGNORE INTO recipe_tag(recipe_id,tag_id) SELECT {0},tag_id FROM recipe_tag WHERE recipe_id IN ({1});"
+										   "UPDATE history SET recipe_id={0} WHERE recipe_id IN ({1});", survivor, id_list).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to merge recipes into recipe with ID {}.", survivor));
+	}
+
+	try {
+		move_attachments(survivor, id_list);
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	// fold the scores of all recipes into the survivor's, decayed to the latest of their times
+	std::vector<std::pair<double, time_t>> scores;
+	if(sqlite3_exec(sqlite_db, std::format("SELECT score,updated_at FROM recipe_score WHERE recipe_id IN ({},{});",
+										   survivor, id_list).c_str(),
+					[](void *scores, int, char **col_data, char**) {
+					static_cast<std::vector<std::pair<double, time_t>>*>(scores)->push_back({ std::atof(col_data[0]),
+																							  std::atoll(col_data[1]) });
+					return 0;
+					}, &scores, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to select scores of recipes merged into recipe with ID {}.", survivor));
+	}
+	if(not scores.empty()) {
+		double score = 0;
+		time_t ref = 0;
+
+		for(const auto &[_, updated_at] : scores)
+			ref = std::max(ref, updated_at);
+		for(const auto &[recipe_score, updated_at] : scores)
+			score += recipe_score * std::exp2(-static_cast<double>(ref - updated_at) / SCORE_HALF_LIFE);
+
+		if(sqlite3_exec(sqlite_db, std::format("INSERT OR REPLACE INTO recipe_score(recipe_id,score,updated_at) VALUES({},{},{});",
+											   survivor, score, ref).c_str(),
+						nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+			sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw std::runtime_error(std::format("Failed to update score of recipe with ID {}.", survivor));
+		}
+	}
+
+	if(sqlite3_exec(sqlite_db, std::format("DELETE FROM recipes WHERE id IN ({});", id_list).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to merge recipes into recipe with ID {}.", survivor));
+	}
+
+	try {
+		update_recipe_minhash(survivor);
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	stale_indexes |= INDEX_RECIPES;
+}
+
+/*
+ * Lower-case a name the way SQLite's lower() does, i.e. only ASCII letters.
+ */
+static std::string ascii_lower(std::string name) {
+	for(auto &c : name) {
+		if(c >= 'A' and c <= 'Z')
+			c += 'a' - 'A';
+	}
+
+	return name;
+}
+
+int db::import_recipes(const std::vector<struct recipe_import> &recipes,
+					   std::unordered_map<std::string, int> &ingredient_ids,
+					   std::unordered_map<std::string, int> &tag_ids) {
+	enum {
+		INSERT_RECIPE, UPDATE_RECIPE, CLEAR_INGREDIENTS, CLEAR_TAGS,
+		INSERT_INGREDIENT, INSERT_TAG, CONN_INGREDIENT, CONN_TAG, SET_MODIFIED, STMT_NUM
+	};
+	static const char *stmt_strs[STMT_NUM] = {
+		"INSERT OR IGNORE INTO recipes(name,description) VALUES(?,?);",
+		"UPDATE recipes SET name=?,description=? WHERE id=?;",
+		"DELETE FROM recipe_ingredient WHERE recipe_id=?;",
+		"DELETE FROM recipe_tag WHERE recipe_id=?;",
+		"INSERT INTO ingredients(name) VALUES(?);",
+		"INSERT INTO tags(name) VALUES(?);",
+		"INSERT OR IGNORE INTO recipe_ingredient(recipe_id,ingredient_id,quantity,unit) VALUES(?,?,nullif(?,0),nullif(lower(?),''));",
+		"INSERT OR IGNORE INTO recipe_tag(recipe_id,tag_id) VALUES(?,?);",
+		"UPDATE recipe_hash SET modified=? WHERE recipe_id=?;",
+	};
+	sqlite3_stmt *stmts[STMT_NUM] = {};
+	int added = 0;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(ingredient_ids.empty() and tag_ids.empty()) {
+		auto load_ids = [](void *ids, int, char **col_data, char**) {
+			if(col_data[1])
+				(*static_cast<std::unordered_map<std::string, int>*>(ids))[ascii_lower(col_data[1])] = std::atoi(col_data[0]);
+			return 0;
+		};
+
+		if(sqlite3_exec(sqlite_db, "SELECT id,name FROM ingredients;", load_ids, &ingredient_ids, nullptr) not_eq SQLITE_OK or
+		   sqlite3_exec(sqlite_db, "SELECT id,name FROM tags;", load_ids, &tag_ids, nullptr) not_eq SQLITE_OK)
+			throw std::runtime_error("Failed to load ingredient and tag names.");
+	}
+
+	auto finalize = [&stmts]() {
+		for(auto stmt : stmts)
+			sqlite3_finalize(stmt);
+	};
+
+	// run a statement that returns no rows, after binding its parameters
+	auto run = [&stmts](const int index, const std::string &error, auto... params) {
+		sqlite3_stmt *stmt = stmts[index];
+		int i = 0;
+
+		sqlite3_reset(stmt);
+		([&](const auto &param) {
+			 ++i;
+			 if constexpr(std::is_same_v<std::decay_t<decltype(param)>, std::string>)
+				 sqlite3_bind_text(stmt, i, param.c_str(), -1, SQLITE_TRANSIENT);
+			 else if constexpr(std::is_floating_point_v<std::decay_t<decltype(param)>>)
+				 sqlite3_bind_double(stmt, i, param);
+			 else
+				 sqlite3_bind_int64(stmt, i, param);
+		 }(params), ...);
+
+		if(sqlite3_step(stmt) not_eq SQLITE_DONE)
+			throw std::runtime_error(error);
+	};
+
+	// resolve a name through a cache, adding it to the database if new
+	auto get_id = [this, &run](const int insert, std::unordered_map<std::string, int> &ids, const std::string &name) {
+		const std::string key = ascii_lower(name);
+		const auto it = ids.find(key);
+
+		if(it not_eq ids.end())
+			return it->second;
+
+		run(insert, std::format("Failed to insert '{}'.", name), name);
+
+		return ids[key] = static_cast<int>(sqlite3_last_insert_rowid(sqlite_db));
+	};
+
+	for(int i = 0; i < STMT_NUM; ++i) {
+		if(sqlite3_prepare_v2(sqlite_db, stmt_strs[i], -1, &stmts[i], nullptr) not_eq SQLITE_OK) {
+			finalize();
+			throw std::runtime_error("Failed to prepare recipe import.");
+		}
+	}
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	try {
+		for(const auto &recipe : recipes) {
+			const std::string error = std::format("Failed to store recipe '{}'.", recipe.name);
+			int recipe_id = recipe.replace_id;
+
+			if(recipe_id > 0) {
+				run(UPDATE_RECIPE, error, recipe.name, recipe.description, recipe_id);
+				run(CLEAR_INGREDIENTS, error, recipe_id);
+				run(CLEAR_TAGS, error, recipe_id);
+			} else {
+				run(INSERT_RECIPE, error, recipe.name, recipe.description);
+				if(sqlite3_changes(sqlite_db) == 0)
+					continue;
+				recipe_id = static_cast<int>(sqlite3_last_insert_rowid(sqlite_db));
+			}
+
+			for(const auto &ingredient : recipe.ingredients) {
+				// ingredient names are always stored lower-cased
+				const int ingredient_id = get_id(INSERT_INGREDIENT, ingredient_ids, ascii_lower(ingredient.name));
+
+				run(CONN_INGREDIENT, error, recipe_id, ingredient_id, ingredient.quantity, ingredient.unit);
+			}
+
+			for(const auto &tag : recipe.tags)
+				run(CONN_TAG, error, recipe_id, get_id(INSERT_TAG, tag_ids, tag));
+
+			if(recipe.modified > 0)
+				run(SET_MODIFIED, error, static_cast<sqlite3_int64>(recipe.modified), recipe_id);
+
+			update_recipe_minhash(recipe_id);
+			++added;
+		}
+	} catch(const std::runtime_error &e) {
+		finalize();
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		// the cached IDs of names added in this transaction are now invalid
+		ingredient_ids.clear();
+		tag_ids.clear();
+		throw;
+	}
+
+	finalize();
+	if(sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		ingredient_ids.clear();
+		tag_ids.clear();
+		throw std::runtime_error("Failed to commit imported recipes.");
+	}
+
+	stale_indexes |= INDEX_INGREDIENTS | INDEX_TAGS | INDEX_RECIPES;
+
+	return added;
+}
+
 int db::add_ingredient(const std::string &name) {
 	if(not sqlite_db)
 		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
@@ -276,18 +1072,41 @@ int db::add_ingredient(const std::string &name) {
 		throw std::runtime_error(std::format("Failed to instert ingredient '{}'.", name));
 	}
 
+	stale_indexes |= INDEX_INGREDIENTS;
+
 	return get_ingredient_id(name);
 }
 
-std::vector<std::string> db::get_recipe_ingredients(const int id) {
-	std::vector<std::string> ingredients;
+name_set db::get_recipe_ingredients(const int id) {
+	name_set ingredients;
 
 	if(not sqlite_db)
 		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
 
 	if(sqlite3_exec(sqlite_db, std::format("SELECT name FROM ingredients WHERE id IN (SELECT ingredient_id FROM recipe_ingredient WHERE recipe_id={});", id).c_str(),
 					[](void *ingredients, int, char **col_data, char**) {
-					static_cast<std::vector<std::string>*>(ingredients)->push_back(col_data[0]);
+					name_set *set = static_cast<name_set*>(ingredients);
+					set->push_back(set->store(col_data[0]));
+					return 0;
+					}, &ingredients, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select ingredients from recipe with ID {}", id));
+	}
+
+	return ingredients;
+}
+
+std::vector<struct ingredient_amount> db::get_recipe_ingredient_amounts(const int id) {
+	std::vector<struct ingredient_amount> ingredients;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT name,coalesce(quantity,0),coalesce(unit,'') FROM recipe_ingredient JOIN ingredients ON ingredients.id=ingredient_id WHERE recipe_id={};", id).c_str(),
+					[](void *ingredients, int, char **col_data, char**) {
+					static_cast<std::vector<struct ingredient_amount>*>(ingredients)->push_back({
+																							   col_data[0],
+																							   std::atof(col_data[1]),
+																							   col_data[2] });
 					return 0;
 					}, &ingredients, nullptr) not_eq SQLITE_OK) {
 		throw std::runtime_error(std::format("Failed to select ingredients from recipe with ID {}", id));
@@ -296,6 +1115,59 @@ std::vector<std::string> db::get_recipe_ingredients(const int id) {
 	return ingredients;
 }
 
+std::map<std::string, struct unit> db::get_units(void) {
+	std::map<std::string, struct unit> units;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, "SELECT name,base,factor FROM units;",
+					[](void *units, int, char **col_data, char**) {
+					(*static_cast<std::map<std::string, struct unit>*>(units))[col_data[0]] = { col_data[1], std::atof(col_data[2]) };
+					return 0;
+					}, &units, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select units.");
+	}
+
+	return units;
+}
+
+std::vector<struct ingredient_amount> db::get_shopping_list(const std::vector<int> &recipe_ids) {
+	std::vector<struct ingredient_amount> list;
+	std::map<int, int> plan;
+	std::string plan_values;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(recipe_ids.empty())
+		return list;
+
+	// a recipe may be planned more than once
+	for(auto id : recipe_ids)
+		++plan[id];
+	for(const auto &[id, times] : plan)
+		plan_values += std::format("{}({},{})", plan_values.empty() ? "" : ",", id, times);
+
+	if(sqlite3_exec(sqlite_db, std::format("WITH plan(recipe_id,times) AS (VALUES {}) "
+										   "SELECT ingredients.name,coalesce(sum(quantity*coalesce(factor,1)*times),0),coalesce(base,unit,'') AS total_unit "
+										   "FROM plan JOIN recipe_ingredient ON recipe_ingredient.recipe_id=plan.recipe_id "
+										   "JOIN ingredients ON ingredients.id=ingredient_id "
+										   "LEFT JOIN units ON units.name=unit "
+										   "GROUP BY ingredients.id,total_unit ORDER BY ingredients.name,total_unit;", plan_values).c_str(),
+					[](void *list, int, char **col_data, char**) {
+					static_cast<std::vector<struct ingredient_amount>*>(list)->push_back({
+																						col_data[0],
+																						std::atof(col_data[1]),
+																						col_data[2] });
+					return 0;
+					}, &list, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to compute shopping list.");
+	}
+
+	return list;
+}
+
 int db::add_tag(const std::string &name) {
 	if(not sqlite_db)
 		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
@@ -305,18 +1177,21 @@ int db::add_tag(const std::string &name) {
 		throw std::runtime_error(std::format("Failed to insert tag '{}'", name));
 	}
 
+	stale_indexes |= INDEX_TAGS;
+
 	return get_tag_id(name);
 }
 
-std::vector<std::string> db::get_recipe_tags(const int id) {
-	std::vector<std::string> tags;
+name_set db::get_recipe_tags(const int id) {
+	name_set tags;
 
 	if(not sqlite_db)
 		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
 
 	if(sqlite3_exec(sqlite_db, std::format("SELECT name FROM tags WHERE id IN (SELECT tag_id FROM recipe_tag WHERE recipe_id={});", id).c_str(),
 					[](void *tags, int, char **col_data, char**) {
-					static_cast<std::vector<std::string>*>(tags)->push_back(col_data[0]);
+					name_set *set = static_cast<name_set*>(tags);
+					set->push_back(set->store(col_data[0]));
 					return 0;
 					}, &tags, nullptr) not_eq SQLITE_OK) {
 		throw std::runtime_error(std::format("Failed to select tags for recipe with ID {}", id));
@@ -334,6 +1209,8 @@ void db::conn_recipe_ingredient(const int recipe_id, const int ingredient_id) {
 		throw std::runtime_error(std::format("Failed to connect recipe with ID {} to ingredient with ID {}",
 												  recipe_id, ingredient_id));
 	}
+
+	update_recipe_minhash(recipe_id);
 }
 
 void db::disconn_recipe_ingredient(const int recipe_id, const int ingredient_id) {
@@ -344,6 +1221,8 @@ void db::disconn_recipe_ingredient(const int recipe_id, const int ingredient_id)
 					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
 		throw std::runtime_error(std::format("Failed to disconnect recipe with ID {} from ingredient with ID {}.", recipe_id, ingredient_id));
 	}
+
+	update_recipe_minhash(recipe_id);
 }
 
 void db::conn_recipe_tag(const int recipe_id, const int tag_id) {
@@ -366,3 +1245,1045 @@ void db::disconn_recipe_tag(const int recipe_id, const int tag_id) {
 		throw std::runtime_error(std::format("Failed to disconnect recipe with ID {} from tag with ID {}.", recipe_id, tag_id));
 	}
 }
+
+int db::add_attachment(const int recipe_id, const std::string &name,
+					   std::istream &data, const sqlite3_int64 size)
+{
+	sqlite3_stmt *stmt;
+	sqlite3_blob *blob;
+	sqlite3_int64 id;
+	char buf[BLOB_CHUNK_SZ];
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_prepare_v2(sqlite_db, "INSERT INTO attachments(recipe_id,name,size,data) VALUES(?,?,?,zeroblob(?));",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare attachment insertion.");
+	}
+	sqlite3_bind_int(stmt, 1, recipe_id);
+	sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64(stmt, 3, size);
+	sqlite3_bind_int64(stmt, 4, size);
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_step(stmt) not_eq SQLITE_DONE) {
+		sqlite3_finalize(stmt);
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to insert attachment '{}' for recipe with ID {}.", name, recipe_id));
+	}
+	sqlite3_finalize(stmt);
+	id = sqlite3_last_insert_rowid(sqlite_db);
+
+	if(sqlite3_blob_open(sqlite_db, "main", "attachments", "data", id, 1, &blob) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to open attachment '{}' for writing.", name));
+	}
+
+	for(sqlite3_int64 offset = 0; offset < size;) {
+		const int len = static_cast<int>(std::min<sqlite3_int64>(BLOB_CHUNK_SZ, size - offset));
+
+		if(not data.read(buf, len) or
+		   sqlite3_blob_write(blob, buf, len, static_cast<int>(offset)) not_eq SQLITE_OK) {
+			sqlite3_blob_close(blob);
+			sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw std::runtime_error(std::format("Failed to write attachment '{}'.", name));
+		}
+		offset += len;
+	}
+
+	sqlite3_blob_close(blob);
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	return static_cast<int>(id);
+}
+
+std::vector<struct attachment> db::get_recipe_attachments(const int recipe_id) {
+	std::vector<struct attachment> attachments;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT id,name,size FROM attachments WHERE recipe_id={} ORDER BY name;", recipe_id).c_str(),
+					[](void *attachments, int, char **col_data, char**) {
+					static_cast<std::vector<struct attachment>*>(attachments)->push_back({
+																						 std::atoi(col_data[0]),
+																						 col_data[1],
+																						 std::atoll(col_data[2]) });
+					return 0;
+					}, &attachments, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select attachments for recipe with ID {}", recipe_id));
+	}
+
+	return attachments;
+}
+
+bool db::read_attachment(const int recipe_id, const std::string &name, std::ostream &out) {
+	sqlite3_stmt *stmt;
+	sqlite3_blob *blob;
+	sqlite3_int64 id, size;
+	char buf[BLOB_CHUNK_SZ];
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_prepare_v2(sqlite_db, "SELECT id,size FROM attachments WHERE recipe_id=? AND name=?;",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare attachment selection.");
+	}
+	sqlite3_bind_int(stmt, 1, recipe_id);
+	sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+
+	if(sqlite3_step(stmt) not_eq SQLITE_ROW) {
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	id = sqlite3_column_int64(stmt, 0);
+	size = sqlite3_column_int64(stmt, 1);
+	sqlite3_finalize(stmt);
+
+	if(sqlite3_blob_open(sqlite_db, "main", "attachments", "data", id, 0, &blob) not_eq SQLITE_OK)
+		throw std::runtime_error(std::format("Failed to open attachment '{}' for reading.", name));
+
+	for(sqlite3_int64 offset = 0; offset < size;) {
+		const int len = static_cast<int>(std::min<sqlite3_int64>(BLOB_CHUNK_SZ, size - offset));
+
+		if(sqlite3_blob_read(blob, buf, len, static_cast<int>(offset)) not_eq SQLITE_OK) {
+			sqlite3_blob_close(blob);
+			throw std::runtime_error(std::format("Failed to read attachment '{}'.", name));
+		}
+		out.write(buf, len);
+		offset += len;
+	}
+
+	sqlite3_blob_close(blob);
+
+	return true;
+}
+
+std::vector<int> db::get_recipe_ingredient_ids(const int id) {
+	std::vector<int> ids;
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT ingredient_id FROM recipe_ingredient WHERE recipe_id={} ORDER BY ingredient_id;", id).c_str(),
+					[](void *ids, int, char **col_data, char**) {
+					static_cast<std::vector<int>*>(ids)->push_back(std::atoi(col_data[0]));
+					return 0;
+					}, &ids, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select ingredients from recipe with ID {}", id));
+	}
+
+	return ids;
+}
+
+void db::update_recipe_minhash(const int recipe_id) {
+	const std::vector<int> ingredients = get_recipe_ingredient_ids(recipe_id);
+	const minhash_sig sig = minhash_signature(ingredients);
+	std::string stmt = std::format("DELETE FROM recipe_lsh WHERE recipe_id={};", recipe_id);
+	sqlite3_stmt *sig_stmt;
+
+	// empty recipes are similar to nothing, so keep them out of the buckets
+	if(not ingredients.empty()) {
+		stmt += "INSERT INTO recipe_lsh(band,bucket,recipe_id) VALUES";
+		for(int band = 0; band < LSH_BANDS; ++band)
+			stmt += std::format("{}({},{},{})", band > 0 ? "," : "", band, lsh_bucket(sig, band), recipe_id);
+		stmt += ";";
+	}
+
+	if(sqlite3_exec(sqlite_db, stmt.c_str(), nullptr, nullptr, nullptr) not_eq SQLITE_OK)
+		throw std::runtime_error(std::format("Failed to update LSH buckets of recipe with ID {}.", recipe_id));
+
+	if(sqlite3_prepare_v2(sqlite_db, "INSERT OR REPLACE INTO recipe_minhash(recipe_id,signature) VALUES(?,?);",
+						  -1, &sig_stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare signature insertion.");
+	}
+	sqlite3_bind_int(sig_stmt, 1, recipe_id);
+	sqlite3_bind_blob(sig_stmt, 2, sig.data(), MINHASH_SZ * sizeof(uint32_t), SQLITE_STATIC);
+	if(sqlite3_step(sig_stmt) not_eq SQLITE_DONE) {
+		sqlite3_finalize(sig_stmt);
+		throw std::runtime_error(std::format("Failed to update signature of recipe with ID {}.", recipe_id));
+	}
+	sqlite3_finalize(sig_stmt);
+}
+
+void db::conn_recipes_ingredients(const std::vector<int> &recipe_ids, const std::vector<int> &ingredient_ids,
+								  const std::vector<struct ingredient_amount> &amounts) {
+	sqlite3_stmt *stmt;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, std::format("INSERT OR IGNORE INTO recipe_ingredient(recipe_id,ingredient_id) SELECT recipes.id,ingredients.id FROM recipes,ingredients WHERE recipes.id IN ({}) AND ingredients.id IN ({});",
+										   join_ids(recipe_ids), join_ids(ingredient_ids)).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error("Failed to connect recipes to ingredients.");
+	}
+
+	if(not amounts.empty()) {
+		if(sqlite3_prepare_v2(sqlite_db, std::format("UPDATE recipe_ingredient SET quantity=?,unit=nullif(lower(?),'') WHERE recipe_id IN ({}) AND ingredient_id=?;",
+													 join_ids(recipe_ids)).c_str(), -1, &stmt, nullptr) not_eq SQLITE_OK) {
+			sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw std::runtime_error("Failed to prepare ingredient amount update.");
+		}
+		for(size_t i = 0; i < ingredient_ids.size() and i < amounts.size(); ++i) {
+			if(amounts[i].quantity == 0)
+				continue;
+
+			sqlite3_bind_double(stmt, 1, amounts[i].quantity);
+			sqlite3_bind_text(stmt, 2, amounts[i].unit.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int(stmt, 3, ingredient_ids[i]);
+			if(sqlite3_step(stmt) not_eq SQLITE_DONE) {
+				sqlite3_finalize(stmt);
+				sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+				throw std::runtime_error(std::format("Failed to set quantity of ingredient with ID {}.", ingredient_ids[i]));
+			}
+			sqlite3_reset(stmt);
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	try {
+		for(auto id : recipe_ids)
+			update_recipe_minhash(id);
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+void db::disconn_recipes_ingredients(const std::vector<int> &recipe_ids, const std::vector<int> &ingredient_ids) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, std::format("DELETE FROM recipe_ingredient WHERE recipe_id IN ({}) AND ingredient_id IN ({});",
+										   join_ids(recipe_ids), join_ids(ingredient_ids)).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error("Failed to disconnect recipes from ingredients.");
+	}
+
+	try {
+		for(auto id : recipe_ids)
+			update_recipe_minhash(id);
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+void db::conn_recipes_tags(const std::vector<int> &recipe_ids, const std::vector<int> &tag_ids) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("INSERT OR IGNORE INTO recipe_tag(recipe_id,tag_id) SELECT recipes.id,tags.id FROM recipes,tags WHERE recipes.id IN ({}) AND tags.id IN ({});",
+										   join_ids(recipe_ids), join_ids(tag_ids)).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to connect recipes to tags.");
+	}
+}
+
+void db::disconn_recipes_tags(const std::vector<int> &recipe_ids, const std::vector<int> &tag_ids) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("DELETE FROM recipe_tag WHERE recipe_id IN ({}) AND tag_id IN ({});",
+										   join_ids(recipe_ids), join_ids(tag_ids)).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to disconnect recipes from tags.");
+	}
+}
+
+void db::merge_ingredients(const std::vector<int> &ids, const int into) {
+	std::vector<int> recipe_ids;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT DISTINCT recipe_id FROM recipe_ingredient WHERE ingredient_id IN ({});", join_ids(ids)).c_str(),
+					[](void *recipe_ids, int, char **col_data, char**) {
+					static_cast<std::vector<int>*>(recipe_ids)->push_back(std::atoi(col_data[0]));
+					return 0;
+					}, &recipe_ids, nullptr) not_eq SQLITE_OK or
+	   sqlite3_exec(sqlite_db, std::format("INSERT OR IGNORE INTO recipe_ingredient(recipe_id,ingredient_id,quantity,unit) SELECT recipe_id,{0},quantity,unit FROM recipe_ingredient WHERE ingredient_id IN ({1});"
+										   "INSERT OR IGNORE INTO substitutes(ingredient_id,substitute_id,weight) SELECT {0},substitute_id,weight FROM substitutes WHERE ingredient_id IN ({1}) AND substitute_id<>{0};"
+										   "INSERT OR IGNORE INTO substitutes(ingredient_id,substitute_id,weight) SELECT ingredient_id,{0},weight FROM substitutes WHERE substitute_id IN ({1}) AND ingredient_id<>{0};"
+										   "DELETE FROM ingredients WHERE id IN ({1}) AND id<>{0};", into, join_ids(ids)).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to merge ingredients into ingredient with ID {}.", into));
+	}
+
+	try {
+		for(auto id : recipe_ids)
+			update_recipe_minhash(id);
+		rebuild_substitute_closure();
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	stale_indexes |= INDEX_INGREDIENTS;
+}
+
+void db::merge_tags(const std::vector<int> &ids, const int into) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	// children of the merged tags move under the one they're merged into, unless that makes a cycle
+	if(sqlite3_exec(sqlite_db, std::format("INSERT OR IGNORE INTO recipe_tag(recipe_id,tag_id) SELECT recipe_id,{0} FROM recipe_tag WHERE tag_id IN ({1});"
+										   "UPDATE tags SET parent_id={0} WHERE parent_id IN ({1}) AND id NOT IN "
+										   "(SELECT ancestor_id FROM tag_closure WHERE descendant_id={0});"
+										   "DELETE FROM tags WHERE id IN ({1}) AND id<>{0};", into, join_ids(ids)).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to merge tags into tag with ID {}.", into));
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	stale_indexes |= INDEX_TAGS;
+}
+
+void db::set_tag_parent(const int id, const int parent_id) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	// the closure of tags is kept by triggers, which refuse to make cycles
+	if(sqlite3_exec(sqlite_db, std::format("UPDATE tags SET parent_id=nullif({},0) WHERE id={};", parent_id, id).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to move tag with ID {}: {}.", id, sqlite3_errmsg(sqlite_db)));
+	}
+}
+
+std::vector<struct tag_node> db::get_tag_tree(void) {
+	std::vector<struct tag_node> tags;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, "SELECT id,coalesce(parent_id,0),name,coalesce(recipes,0) FROM tags "
+					"LEFT JOIN tag_stats ON tag_id=id ORDER BY name;",
+					[](void *tags, int, char **col_data, char**) {
+					static_cast<std::vector<struct tag_node>*>(tags)->push_back({
+																				std::atoi(col_data[0]),
+																				std::atoi(col_data[1]),
+																				col_data[2] ? col_data[2] : "",
+																				std::atoi(col_data[3]) });
+					return 0;
+					}, &tags, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select tags.");
+	}
+
+	return tags;
+}
+
+void db::rename_ingredient(const int id, const std::string &new_name) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("UPDATE ingredients SET name=lower('{}') WHERE id={};", new_name, id).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to rename ingredient with ID {}.", id));
+	}
+
+	stale_indexes |= INDEX_INGREDIENTS;
+}
+
+void db::add_cooked(const int recipe_id, const time_t when) {
+	sqlite3_stmt *stmt;
+	double score = 0;
+	time_t updated_at = when;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_prepare_v2(sqlite_db, "SELECT score,updated_at FROM recipe_score WHERE recipe_id=?;",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error("Failed to prepare score selection.");
+	}
+	sqlite3_bind_int(stmt, 1, recipe_id);
+	if(sqlite3_step(stmt) == SQLITE_ROW) {
+		score = sqlite3_column_double(stmt, 0);
+		updated_at = sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+
+	// bring both the old score and the new meal to the latest of their times
+	const time_t ref = std::max(when, updated_at);
+	score = score * std::exp2(-static_cast<double>(ref - updated_at) / SCORE_HALF_LIFE)
+		+ std::exp2(-static_cast<double>(ref - when) / SCORE_HALF_LIFE);
+
+	if(sqlite3_exec(sqlite_db, std::format("INSERT INTO history(recipe_id,cooked_at) VALUES({0},{1});"
+										   "INSERT OR REPLACE INTO recipe_score(recipe_id,score,updated_at) VALUES({0},{2},{3});",
+										   recipe_id, when, score, ref).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to record cooking of recipe with ID {}.", recipe_id));
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+std::map<int, double> db::get_recipe_scores(const time_t now) {
+	std::vector<std::tuple<int, double, time_t>> rows;
+	std::map<int, double> scores;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, "SELECT recipe_id,score,updated_at FROM recipe_score;",
+					[](void *rows, int, char **col_data, char**) {
+					static_cast<std::vector<std::tuple<int, double, time_t>>*>(rows)->push_back({
+																							   std::atoi(col_data[0]),
+																							   std::atof(col_data[1]),
+																							   std::atoll(col_data[2]) });
+					return 0;
+					}, &rows, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select recipe scores.");
+	}
+
+	for(const auto &[id, score, updated_at] : rows)
+		scores[id] = score * std::exp2(-static_cast<double>(std::max<time_t>(now - updated_at, 0)) / SCORE_HALF_LIFE);
+
+	return scores;
+}
+
+void db::set_ingredient_nutrition(const int ingredient_id, const std::string &unit, const nutrient_vec &values) {
+	sqlite3_stmt *stmt;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_prepare_v2(sqlite_db, "INSERT OR REPLACE INTO ingredient_nutrition(ingredient_id,unit,nutrients) VALUES(?,?,?);",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare nutrition insertion.");
+	}
+	sqlite3_bind_int(stmt, 1, ingredient_id);
+	sqlite3_bind_text(stmt, 2, unit.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_blob(stmt, 3, values.data(), sizeof(values), SQLITE_STATIC);
+
+	if(sqlite3_step(stmt) not_eq SQLITE_DONE) {
+		sqlite3_finalize(stmt);
+		throw std::runtime_error(std::format("Failed to set nutrition of ingredient with ID {}.", ingredient_id));
+	}
+	sqlite3_finalize(stmt);
+}
+
+void db::update_nutrition_cache(void) {
+	std::unordered_map<int, size_t> ingr_index, recipe_index;
+	std::vector<float> ingr_nutrients, totals;
+	// recipes to compute, with how many of their ingredients are counted, out of all
+	struct recipes {
+		std::vector<int> ids, counted, sizes;
+	} recipes;
+	std::vector<int> &recipe_ids = recipes.ids;
+	// links to compute, as a structure of arrays
+	std::vector<size_t> link_recipe, link_ingr;
+	std::vector<float> link_quantity;
+	sqlite3_stmt *stmt;
+
+	if(sqlite3_exec(sqlite_db, "SELECT id,coalesce(ingredients,0) FROM recipes LEFT JOIN recipe_size ON recipe_id=id "
+					"WHERE id NOT IN (SELECT recipe_id FROM recipe_nutrition);",
+					[](void *data, int, char **col_data, char**) {
+					auto *recipes = static_cast<struct recipes*>(data);
+					recipes->ids.push_back(std::atoi(col_data[0]));
+					recipes->sizes.push_back(std::atoi(col_data[1]));
+					return 0;
+					}, &recipes, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select recipes without nutrition.");
+	}
+
+	if(recipe_ids.empty())
+		return;
+	recipes.counted.assign(recipe_ids.size(), 0);
+
+	for(size_t i = 0; i < recipe_ids.size(); ++i)
+		recipe_index[recipe_ids[i]] = i;
+
+	if(sqlite3_prepare_v2(sqlite_db, "SELECT ingredient_id,nutrients FROM ingredient_nutrition;",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare nutrition selection.");
+	}
+	while(sqlite3_step(stmt) == SQLITE_ROW) {
+		if(sqlite3_column_bytes(stmt, 1) not_eq sizeof(nutrient_vec))
+			continue;
+
+		const float *values = static_cast<const float*>(sqlite3_column_blob(stmt, 1));
+		ingr_index[sqlite3_column_int(stmt, 0)] = ingr_nutrients.size() / NUTRIENT_VEC_SZ;
+		ingr_nutrients.insert(ingr_nutrients.end(), values, values + NUTRIENT_VEC_SZ);
+	}
+	sqlite3_finalize(stmt);
+
+	// only amounts in the same base unit as the nutrition data can be counted
+	if(sqlite3_prepare_v2(sqlite_db, "SELECT recipe_id,recipe_ingredient.ingredient_id,quantity*coalesce(factor,1) FROM recipe_ingredient "
+						  "JOIN ingredient_nutrition ON ingredient_nutrition.ingredient_id=recipe_ingredient.ingredient_id "
+						  "LEFT JOIN units ON units.name=recipe_ingredient.unit "
+						  "WHERE quantity IS NOT NULL AND ingredient_nutrition.unit=coalesce(base,recipe_ingredient.unit,'') "
+						  "AND recipe_id NOT IN (SELECT recipe_id FROM recipe_nutrition);",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare recipe ingredient selection.");
+	}
+	while(sqlite3_step(stmt) == SQLITE_ROW) {
+		const auto recipe = recipe_index.find(sqlite3_column_int(stmt, 0));
+		const auto ingr = ingr_index.find(sqlite3_column_int(stmt, 1));
+
+		if(recipe == recipe_index.end() or ingr == ingr_index.end())
+			continue;
+		++recipes.counted[recipe->second];
+		link_recipe.push_back(recipe->second);
+		link_ingr.push_back(ingr->second);
+		link_quantity.push_back(static_cast<float>(sqlite3_column_double(stmt, 2)));
+	}
+	sqlite3_finalize(stmt);
+
+	totals.assign(recipe_ids.size() * NUTRIENT_VEC_SZ, 0);
+	for(size_t i = 0; i < link_recipe.size(); ++i) {
+		nutrient_add_scaled(&totals[link_recipe[i] * NUTRIENT_VEC_SZ],
+							&ingr_nutrients[link_ingr[i] * NUTRIENT_VEC_SZ],
+							link_quantity[i]);
+	}
+
+	if(sqlite3_prepare_v2(sqlite_db, "INSERT OR REPLACE INTO recipe_nutrition(recipe_id,kcal,nutrients,counted,ingredients) VALUES(?,?,?,?,?);",
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare nutrition cache insertion.");
+	}
+
+	const int kcal = nutrient_index("kcal");
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+	for(size_t i = 0; i < recipe_ids.size(); ++i) {
+		const float *values = &totals[i * NUTRIENT_VEC_SZ];
+
+		sqlite3_bind_int(stmt, 1, recipe_ids[i]);
+		sqlite3_bind_double(stmt, 2, values[kcal]);
+		sqlite3_bind_blob(stmt, 3, values, sizeof(nutrient_vec), SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 4, recipes.counted[i]);
+		sqlite3_bind_int(stmt, 5, recipes.sizes[i]);
+		if(sqlite3_step(stmt) not_eq SQLITE_DONE) {
+			sqlite3_finalize(stmt);
+			sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw std::runtime_error("Failed to update nutrition cache.");
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+	sqlite3_finalize(stmt);
+}
+
+std::map<int, struct recipe_nutrition> db::get_recipe_nutrition(const std::vector<int> &ids) {
+	std::map<int, struct recipe_nutrition> nutrition;
+	sqlite3_stmt *stmt;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	update_nutrition_cache();
+
+	if(sqlite3_prepare_v2(sqlite_db, std::format("SELECT recipe_id,nutrients,counted,ingredients FROM recipe_nutrition WHERE recipe_id IN ({});", join_ids(ids)).c_str(),
+						  -1, &stmt, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to prepare nutrition selection.");
+	}
+	while(sqlite3_step(stmt) == SQLITE_ROW) {
+		struct recipe_nutrition values;
+
+		if(sqlite3_column_bytes(stmt, 1) not_eq sizeof(values.nutrients))
+			continue;
+		std::copy_n(static_cast<const float*>(sqlite3_column_blob(stmt, 1)), NUTRIENT_VEC_SZ, values.nutrients.begin());
+		values.counted = sqlite3_column_int(stmt, 2);
+		values.ingredients = sqlite3_column_int(stmt, 3);
+		nutrition[sqlite3_column_int(stmt, 0)] = values;
+	}
+	sqlite3_finalize(stmt);
+
+	return nutrition;
+}
+
+void db::add_substitute(const int ingredient_id, const int substitute_id, const double weight) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(ingredient_id == substitute_id)
+		return;
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	/*
+	 * Everything that could already be replaced by the ingredient (and the
+	 * ingredient itself) can now be replaced by the substitute and everything
+	 * that can replace it.
+	 */
+	if(sqlite3_exec(sqlite_db, std::format("INSERT OR REPLACE INTO substitutes(ingredient_id,substitute_id,weight) VALUES({0},{1},{2});"
+										   "INSERT OR IGNORE INTO substitute_closure(ingredient_id,substitute_id) "
+										   "SELECT src.id,dst.id FROM "
+										   "(SELECT {0} AS id UNION SELECT ingredient_id FROM substitute_closure WHERE substitute_id={0}) AS src, "
+										   "(SELECT {1} AS id UNION SELECT substitute_id FROM substitute_closure WHERE ingredient_id={1}) AS dst "
+										   "WHERE src.id<>dst.id;", ingredient_id, substitute_id, weight).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to add substitute with ID {} for ingredient with ID {}.", substitute_id, ingredient_id));
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+void db::del_substitute(const int ingredient_id, const int substitute_id) {
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, std::format("DELETE FROM substitutes WHERE ingredient_id={} AND substitute_id={};", ingredient_id, substitute_id).c_str(),
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to remove substitute with ID {} for ingredient with ID {}.", substitute_id, ingredient_id));
+	}
+
+	try {
+		rebuild_substitute_closure();
+	} catch(...) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw;
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+std::vector<std::string> db::get_substitutes(const int ingredient_id) {
+	std::vector<std::string> substitutes;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT name FROM substitute_closure JOIN ingredients ON ingredients.id=substitute_id WHERE ingredient_id={} ORDER BY name;", ingredient_id).c_str(),
+					[](void *substitutes, int, char **col_data, char**) {
+					static_cast<std::vector<std::string>*>(substitutes)->push_back(col_data[0]);
+					return 0;
+					}, &substitutes, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select substitutes of ingredient with ID {}.", ingredient_id));
+	}
+
+	return substitutes;
+}
+
+void db::rebuild_substitute_closure(void) {
+	// removing an edge may cut any number of paths, so start over
+	if(sqlite3_exec(sqlite_db, "DELETE FROM substitute_closure;"
+					"INSERT INTO substitute_closure(ingredient_id,substitute_id) "
+					"WITH RECURSIVE reach(src,dst) AS (SELECT ingredient_id,substitute_id FROM substitutes "
+					"UNION SELECT reach.src,substitutes.substitute_id FROM reach JOIN substitutes ON substitutes.ingredient_id=reach.dst) "
+					"SELECT src,dst FROM reach WHERE src<>dst;",
+					nullptr, nullptr, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to rebuild substitute closure.");
+	}
+}
+
+std::string db::get_name_index_path(const enum name_kind kind) {
+	static const char *file_names[NAME_KIND_NUM] = {
+		"ingredients.idx",
+		"tags.idx",
+		"recipes.idx",
+		"recipe-ids.idx",
+	};
+
+	return get_data_dir() + "/" + file_names[kind];
+}
+
+void db::rebuild_name_index(const enum name_kind kind) {
+	static const char *stmts[NAME_KIND_NUM] = {
+		"SELECT name FROM ingredients;",
+		"SELECT name FROM tags;",
+		"SELECT name FROM recipes;",
+		"SELECT id,name FROM recipes;",
+	};
+	std::vector<std::pair<std::string, std::string>> entries;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, stmts[kind],
+					[](void *entries, int col_num, char **col_data, char**) {
+					if(not col_data[0] or not *col_data[col_num - 1])
+						return 0;
+					// IDs are completed by number, but shown along with the name
+					const std::string value = col_num > 1 ?
+						std::format("{}\t{}", col_data[0], col_data[1] ? col_data[1] : "") : col_data[0];
+					static_cast<std::vector<std::pair<std::string, std::string>>*>(entries)->push_back({
+																									   prefix_index_key(col_data[0]),
+																									   value });
+					return 0;
+					}, &entries, nullptr) not_eq SQLITE_OK or
+	   not write_prefix_index(get_name_index_path(kind), entries)) {
+		std::cerr << "Failed to update completion index " << get_name_index_path(kind) << "." << std::endl;
+	}
+}
+
+void db::backup(const std::string &dest, const int pages_per_step,
+				const std::function<void(int, int)> &progress) {
+	sqlite3 *dest_db;
+	sqlite3_backup *backup;
+	int ret;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_open(dest.c_str(), &dest_db) not_eq SQLITE_OK) {
+		sqlite3_close(dest_db);
+		throw std::runtime_error("Failed to open backup file " + dest);
+	}
+
+	if(not (backup = sqlite3_backup_init(dest_db, "main", sqlite_db, "main"))) {
+		const std::string error = sqlite3_errmsg(dest_db);
+		sqlite3_close(dest_db);
+		throw std::runtime_error(std::format("Failed to start backup: {}", error));
+	}
+
+	do {
+		ret = sqlite3_backup_step(backup, pages_per_step);
+		progress(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup));
+		// locked by another connection, or just letting others get a turn
+		if(ret == SQLITE_OK or ret == SQLITE_BUSY or ret == SQLITE_LOCKED)
+			sqlite3_sleep(BACKUP_STEP_PAUSE);
+	} while(ret == SQLITE_OK or ret == SQLITE_BUSY or ret == SQLITE_LOCKED);
+
+	sqlite3_backup_finish(backup);
+	if(ret not_eq SQLITE_DONE) {
+		const std::string error = sqlite3_errstr(ret);
+		sqlite3_close(dest_db);
+		throw std::runtime_error(std::format("Failed to back up database: {}", error));
+	}
+
+	sqlite3_close(dest_db);
+}
+
+std::vector<std::string> db::check_integrity(const std::string &path) {
+	std::vector<std::string> problems;
+	sqlite3 *check_db;
+
+	if(sqlite3_open_v2(path.c_str(), &check_db, SQLITE_OPEN_READONLY, nullptr) not_eq SQLITE_OK) {
+		sqlite3_close(check_db);
+		throw std::runtime_error("Failed to open database file " + path);
+	}
+
+	if(sqlite3_exec(check_db, "PRAGMA integrity_check;",
+					[](void *problems, int, char **col_data, char**) {
+					if(col_data[0] and std::string(col_data[0]) not_eq "ok")
+						static_cast<std::vector<std::string>*>(problems)->push_back(col_data[0]);
+					return 0;
+					}, &problems, nullptr) not_eq SQLITE_OK) {
+		problems.push_back(sqlite3_errmsg(check_db));
+	}
+
+	sqlite3_close(check_db);
+
+	return problems;
+}
+
+int db::get_changes(const int since, std::vector<int> &changed, std::vector<int> &deleted) {
+	std::pair<std::vector<int>*, std::vector<int>*> lists(&changed, &deleted);
+	int last_seq = 0;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	// read the changes and the last sequence number from the same snapshot
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, "SELECT coalesce(max(seq),0) FROM changelog;",
+					[](void *last_seq, int, char **col_data, char**) {
+					*static_cast<int*>(last_seq) = std::atoi(col_data[0]);
+					return 0;
+					}, &last_seq, nullptr) not_eq SQLITE_OK or
+	   sqlite3_exec(sqlite_db, std::format("SELECT id,id IN (SELECT id FROM recipes) FROM ("
+										   "SELECT recipe_id AS id FROM changelog WHERE seq>{0} AND recipe_id IS NOT NULL "
+										   "UNION SELECT recipe_id FROM recipe_ingredient WHERE ingredient_id IN "
+										   "(SELECT item_id FROM changelog WHERE seq>{0} AND op='rename_ingredient') "
+										   "UNION SELECT recipe_id FROM recipe_tag WHERE tag_id IN "
+										   "(SELECT item_id FROM changelog WHERE seq>{0} AND op='rename_tag')) ORDER BY id;",
+										   since).c_str(),
+					[](void *lists, int, char **col_data, char**) {
+					auto *changes = static_cast<std::pair<std::vector<int>*, std::vector<int>*>*>(lists);
+					(std::atoi(col_data[1]) ? changes->first : changes->second)->push_back(std::atoi(col_data[0]));
+					return 0;
+					}, &lists, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error(std::format("Failed to get changes since {}.", since));
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	return last_seq;
+}
+
+void db::update_recipe_hashes(void) {
+	std::vector<int> ids;
+	sqlite3_stmt *stmt;
+
+	if(sqlite3_exec(sqlite_db, "SELECT recipe_id FROM recipe_hash WHERE hash IS NULL;",
+					[](void *ids, int, char **col_data, char**) {
+					static_cast<std::vector<int>*>(ids)->push_back(std::atoi(col_data[0]));
+					return 0;
+					}, &ids, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select recipes without hashes.");
+	}
+
+	if(ids.empty())
+		return;
+
+	if(sqlite3_prepare_v2(sqlite_db, "UPDATE recipe_hash SET hash=? WHERE recipe_id=?;", -1, &stmt, nullptr) not_eq SQLITE_OK)
+		throw std::runtime_error("Failed to prepare hash update.");
+
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	for(const int id : ids) {
+		const struct recipe recipe = get_recipe(id);
+		const name_set tag_set = get_recipe_tags(id);
+		std::vector<std::string> ingredients;
+		std::vector<std::string> tags;
+		// fields are separated by unit separators, and lists by record separators
+		std::string content = recipe.name + "\x1f" + recipe.description;
+
+		for(const auto &ingredient : get_recipe_ingredient_amounts(id))
+			ingredients.push_back(std::format("{}\x1f{:g}\x1f{}", ingredient.name, ingredient.quantity, ingredient.unit));
+		// tags are matched ignoring case across databases, like imports resolve them
+		for(const auto &tag : tag_set)
+			tags.push_back(ascii_lower(std::string(tag)));
+		std::sort(ingredients.begin(), ingredients.end());
+		std::sort(tags.begin(), tags.end());
+
+		for(const auto &ingredient : ingredients)
+			content += "\x1e" + ingredient;
+		content += "\x1d";
+		for(const auto &tag : tags)
+			content += "\x1e" + tag;
+
+		sqlite3_reset(stmt);
+		sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(hash_string(content)));
+		sqlite3_bind_int(stmt, 2, id);
+		if(sqlite3_step(stmt) not_eq SQLITE_DONE) {
+			sqlite3_finalize(stmt);
+			sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw std::runtime_error(std::format("Failed to store hash of recipe with ID {}.", id));
+		}
+	}
+
+	sqlite3_finalize(stmt);
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+std::vector<struct recipe_hash> db::get_recipe_hashes(void) {
+	std::vector<struct recipe_hash> hashes;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	update_recipe_hashes();
+
+	if(sqlite3_exec(sqlite_db, "SELECT id,name,hash,modified FROM recipe_hash JOIN recipes ON id=recipe_id;",
+					[](void *hashes, int, char **col_data, char**) {
+					static_cast<std::vector<struct recipe_hash>*>(hashes)->push_back({
+																						std::atoi(col_data[0]),
+																						hash_string(ascii_lower(col_data[1] ? col_data[1] : "")),
+																						static_cast<uint64_t>(col_data[2] ? std::strtoll(col_data[2], nullptr, 10) : 0),
+																						std::strtoll(col_data[3], nullptr, 10) });
+					return 0;
+					}, &hashes, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select recipe hashes.");
+	}
+
+	std::sort(hashes.begin(), hashes.end(),
+			  [](const struct recipe_hash &a, const struct recipe_hash &b) { return a.key < b.key; });
+
+	return hashes;
+}
+
+/*
+ * Counter table of a kind of names, along with the column of their IDs and the
+ * table of their names.
+ */
+static std::tuple<const char*, const char*, const char*> stats_table(const enum name_kind kind) {
+	switch(kind) {
+	case NAMES_INGREDIENTS:
+		return { "ingredient_stats", "ingredient_id", "ingredients" };
+	case NAMES_TAGS:
+		return { "tag_stats", "tag_id", "tags" };
+	default:
+		throw std::runtime_error(std::format("{}: No statistics for kind {}. Please contact a developer.", __PRETTY_FUNCTION__, static_cast<int>(kind)));
+	}
+}
+
+std::map<int, int> db::get_recipe_counts(const enum name_kind kind, const std::vector<int> &ids) {
+	const auto [table, id_column, names] = stats_table(kind);
+	std::map<int, int> counts;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(ids.empty())
+		return counts;
+
+	// tags count the recipes of their descendants too
+	const std::string query = kind == NAMES_TAGS ?
+		std::format("SELECT ancestor_id,sum(recipes) FROM tag_closure JOIN tag_stats ON tag_id=descendant_id "
+					"WHERE ancestor_id IN ({}) GROUP BY ancestor_id;", join_ids(ids)) :
+		std::format("SELECT {0},recipes FROM {1} WHERE {0} IN ({2});", id_column, table, join_ids(ids));
+
+	if(sqlite3_exec(sqlite_db, query.c_str(),
+					[](void *counts, int, char **col_data, char**) {
+					(*static_cast<std::map<int, int>*>(counts))[std::atoi(col_data[0])] = std::atoi(col_data[1]);
+					return 0;
+					}, &counts, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to get recipe counts from {}.", table));
+	}
+
+	return counts;
+}
+
+std::vector<struct name_count> db::get_top_names(const enum name_kind kind, const int count) {
+	const auto [table, id_column, names] = stats_table(kind);
+	std::vector<struct name_count> top;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT name,recipes FROM {0} JOIN {2} ON id={1} WHERE recipes>0 "
+										   "ORDER BY recipes DESC LIMIT {3};",
+										   table, id_column, names, count).c_str(),
+					[](void *top, int, char **col_data, char**) {
+					static_cast<std::vector<struct name_count>*>(top)->push_back({
+																				 col_data[0] ? col_data[0] : "",
+																				 std::atoi(col_data[1]) });
+					return 0;
+					}, &top, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to get the most used {}.", names));
+	}
+
+	return top;
+}
+
+struct catalog_stats db::get_catalog_stats(void) {
+	struct catalog_stats stats = {};
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	// both from the same snapshot
+	sqlite3_exec(sqlite_db, "BEGIN;", nullptr, nullptr, nullptr);
+
+	if(sqlite3_exec(sqlite_db, "SELECT ingredients,recipes FROM recipe_size_histogram WHERE recipes>0;",
+					[](void *stats, int, char **col_data, char**) {
+					auto *catalog = static_cast<struct catalog_stats*>(stats);
+					catalog->sizes[std::atoi(col_data[0])] = std::atoi(col_data[1]);
+					catalog->recipes += std::atoi(col_data[1]);
+					return 0;
+					}, &stats, nullptr) not_eq SQLITE_OK or
+	   sqlite3_exec(sqlite_db, "SELECT (SELECT count(*) FROM ingredient_stats),"
+					"(SELECT count(*) FROM ingredient_stats WHERE recipes=0),"
+					"(SELECT count(*) FROM tag_stats),"
+					"(SELECT count(*) FROM tag_stats WHERE recipes=0);",
+					[](void *stats, int, char **col_data, char**) {
+					auto *catalog = static_cast<struct catalog_stats*>(stats);
+					catalog->ingredients = std::atoi(col_data[0]);
+					catalog->unused_ingredients = std::atoi(col_data[1]);
+					catalog->tags = std::atoi(col_data[2]);
+					catalog->unused_tags = std::atoi(col_data[3]);
+					return 0;
+					}, &stats, nullptr) not_eq SQLITE_OK) {
+		sqlite3_exec(sqlite_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		throw std::runtime_error("Failed to get catalog statistics.");
+	}
+
+	sqlite3_exec(sqlite_db, "COMMIT;", nullptr, nullptr, nullptr);
+
+	return stats;
+}
+
+std::map<std::string, std::vector<int>> db::get_recipes_by_name(const enum name_kind kind) {
+	const auto [table, id_column, names] = stats_table(kind);
+	struct lists {
+		// the ancestors of every tag, including itself
+		std::unordered_map<int, std::vector<int>> ancestors;
+		// IDs of the recipes by ingredient or tag ID
+		std::unordered_map<int, std::vector<int>> by_id;
+		std::map<std::string, std::vector<int>> by_name;
+	} lists;
+
+	if(not sqlite_db)
+		throw std::runtime_error(std::format("{}: Database not open! Please contact a developer.", __PRETTY_FUNCTION__));
+
+	if(kind == NAMES_TAGS and
+	   sqlite3_exec(sqlite_db, "SELECT descendant_id,ancestor_id FROM tag_closure;",
+					[](void *lists, int, char **col_data, char**) {
+					static_cast<struct lists*>(lists)->ancestors[std::atoi(col_data[0])].push_back(std::atoi(col_data[1]));
+					return 0;
+					}, &lists, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error("Failed to select the ancestors of tags.");
+	}
+
+	/*
+	 * Ordering by recipe follows the index of the link table, so every list
+	 * comes out sorted without SQLite having to sort anything.
+	 */
+	if(sqlite3_exec(sqlite_db, std::format("SELECT {},recipe_id FROM {} ORDER BY recipe_id;", id_column,
+										   kind == NAMES_TAGS ? "recipe_tag" : "recipe_ingredient").c_str(),
+					[](void *data, int, char **col_data, char**) {
+					auto *lists = static_cast<struct lists*>(data);
+					const int id = std::atoi(col_data[0]), recipe_id = std::atoi(col_data[1]);
+					const auto ancestors = lists->ancestors.find(id);
+
+					if(ancestors == lists->ancestors.end()) {
+						lists->by_id[id].push_back(recipe_id);
+						return 0;
+					}
+					for(const int ancestor_id : ancestors->second) {
+						std::vector<int> &list = lists->by_id[ancestor_id];
+						// two tags of a recipe may share an ancestor
+						if(list.empty() or list.back() not_eq recipe_id)
+							list.push_back(recipe_id);
+					}
+					return 0;
+					}, &lists, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select recipes by {}.", names));
+	}
+
+	if(sqlite3_exec(sqlite_db, std::format("SELECT id,lower(name) FROM {};", names).c_str(),
+					[](void *data, int, char **col_data, char**) {
+					auto *lists = static_cast<struct lists*>(data);
+					const auto ids = lists->by_id.find(std::atoi(col_data[0]));
+
+					if(ids == lists->by_id.end() or not col_data[1])
+						return 0;
+
+					// names differing only in case share a list
+					std::vector<int> &list = lists->by_name[col_data[1]];
+					if(list.empty()) {
+						list = std::move(ids->second);
+					} else {
+						std::vector<int> merged;
+						std::set_union(list.begin(), list.end(), ids->second.begin(), ids->second.end(),
+									   std::back_inserter(merged));
+						list = std::move(merged);
+					}
+					return 0;
+					}, &lists, nullptr) not_eq SQLITE_OK) {
+		throw std::runtime_error(std::format("Failed to select the names of {}.", names));
+	}
+
+	return std::move(lists.by_name);
+}
@@ -17,8 +17,20 @@
  */
 #pragma once
 
+#include "arena.hpp"
+#include "nutrition.hpp"
+#include "query_cache.hpp"
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
 #include <sqlite3.h>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 struct recipe {
@@ -27,18 +39,167 @@ struct recipe {
 	std::string description;
 };
 
+// a recipe whose strings belong to the result set it came in
+struct recipe_view {
+	int id;
+	std::string_view name;
+	std::string_view description;
+};
+
+typedef result_set<struct recipe_view> recipe_set;
+typedef result_set<std::string_view> name_set;
+
+struct ingredient_amount {
+	std::string name;
+	double quantity; // 0 if unspecified
+	std::string unit; // empty for plain counts
+};
+
+struct unit {
+	std::string base;
+	double factor; // amount of base in one unit
+};
+
+struct scored_recipe {
+	struct recipe recipe;
+	double score;
+};
+
+struct attachment {
+	int id;
+	std::string name;
+	sqlite3_int64 size;
+};
+
+struct recipe_import {
+	std::string name;
+	std::string description;
+	std::vector<struct ingredient_amount> ingredients;
+	std::vector<std::string> tags;
+	// time of the last modification to keep, 0 for now
+	time_t modified;
+	// ID of an existing recipe to overwrite, 0 to add a new one
+	int replace_id;
+};
+
+struct recipe_hash {
+	int id;
+	// hash of the lower-cased name, which identifies a recipe across databases
+	uint64_t key;
+	// hash of the name, description, ingredients and tags
+	uint64_t hash;
+	time_t modified;
+};
+
+struct tag_node {
+	int id;
+	int parent_id; // 0 for top-level tags
+	std::string name;
+	int recipes; // tagged with this tag itself
+};
+
+struct name_count {
+	std::string name;
+	int recipes;
+};
+
+struct recipe_nutrition {
+	nutrient_vec nutrients;
+	// ingredients that could be counted towards the nutrients, out of all
+	int counted, ingredients;
+};
+
+struct catalog_stats {
+	int recipes, ingredients, tags;
+	// ingredients and tags no recipe uses
+	int unused_ingredients, unused_tags;
+	// number of recipes with each number of ingredients
+	std::map<int, int> sizes;
+};
+
+/*
+ * Kinds of names kept in completion indexes.
+ */
+enum name_kind {
+	NAMES_INGREDIENTS = 0,
+	NAMES_TAGS,
+	NAMES_RECIPES,
+	NAMES_RECIPE_IDS,
+	NAME_KIND_NUM,
+};
+
+#define INDEX_INGREDIENTS (1 << NAMES_INGREDIENTS)
+#define INDEX_TAGS (1 << NAMES_TAGS)
+#define INDEX_RECIPES ((1 << NAMES_RECIPES) | (1 << NAMES_RECIPE_IDS))
+
 class db {
 private:
 	sqlite3 *sqlite_db;
+	// completion indexes to rebuild on close, as INDEX_* flags
+	int stale_indexes;
+	bool default_db;
+	// results of filtered queries, kept for the default database only
+	query_cache cache;
 	int table_get_id_by_name(const std::string &table, const std::string &name);
+	int get_db_version(void);
+	void upgrade(void);
+	std::vector<int> get_recipe_ingredient_ids(const int id);
+	void update_recipe_minhash(const int recipe_id);
+	void move_attachments(const int survivor, const std::string &id_list);
+	void update_nutrition_cache(void);
+	void rebuild_substitute_closure(void);
+	void update_recipe_hashes(void);
+	recipe_set select_recipes(const std::string &stmt);
+	recipe_set get_cached_recipes(const std::string &stmt, const std::string &key);
+	uint32_t get_change_counter(void);
 
 public:
-	db() : sqlite_db(nullptr) {}
+	db() : sqlite_db(nullptr), stale_indexes(0), default_db(false) {}
 	~db() {
-		sqlite3_close(sqlite_db);
+		close();
 	}
 	void open(void);
+	/**
+	 * @brief Open (creating or upgrading if needed) a database other than the
+	 * default one.
+	 *
+	 * @param path Path of the database file.
+	 */
+	void open(const std::string &path);
+	/**
+	 * @brief Open a database read-only, without creating or upgrading it. The
+	 * connection is meant to be used by a single thread.
+	 *
+	 * @param path Path of the database file.
+	 */
+	void open_read_only(const std::string &path);
 	void close(void);
+	/**
+	 * @brief Get the result code of the last failed SQLite call, e.g.
+	 * SQLITE_BUSY if another connection held the lock it needed.
+	 */
+	int get_error_code(void);
+
+	/**
+	 * @brief Get the databases listed in the MENU_HELPER_PATH environment
+	 * variable (colon-separated), or none if it isn't set.
+	 */
+	static std::vector<std::string> get_search_path(void);
+
+	/**
+	 * @brief Get the path of the completion index of a kind of names. Indexes
+	 * are rebuilt when the database is closed after their names changed.
+	 */
+	static std::string get_name_index_path(const enum name_kind kind);
+	void rebuild_name_index(const enum name_kind kind);
+
+	/**
+	 * @brief Get the cache of filtered queries of the default database, and
+	 * its hits and misses.
+	 */
+	const query_cache &get_query_cache(void) const {
+		return cache;
+	}
 
 	/**
 	 * @brief Add a new recipe to the database.
@@ -58,11 +219,85 @@ public:
 		return (get_recipe_id(name) > 0);
 	}
 	bool recipe_exists(const int id);
+	/**
+	 * @brief Check which of a list of recipes exist, in a single query.
+	 *
+	 * @return IDs from ids that belong to a recipe.
+	 */
+	std::vector<int> get_existing_recipe_ids(const std::vector<int> &ids);
 	struct recipe get_recipe(const int id);
 	void update_recipe_name(const int id, const std::string &new_name);
 	void update_recipe_desc(const int id, const std::string &new_desc);
-	std::vector<struct recipe> get_recipes(const std::vector<std::string> &ingredients,
-										   const std::vector<std::string> &tags);
+	/**
+	 * @brief Get the recipes with all the given ingredients and tags.
+	 *
+	 * @param ingredients Names of the ingredients to filter by.
+	 * @param tags Names of the tags to filter by.
+	 * @param max_kcal If positive, only get recipes with at most this energy.
+	 * @param allow_subs Whether to match ingredients by their substitutes too.
+	 *
+	 * @return The recipes, sorted by ID.
+	 */
+	recipe_set get_recipes(const std::vector<std::string> &ingredients,
+						   const std::vector<std::string> &tags,
+						   const double max_kcal = 0,
+						   const bool allow_subs = false);
+	/**
+	 * @brief Find the recipes whose ingredients are most similar to those of
+	 * another. Candidates are retrieved through the LSH buckets of the
+	 * recipe's MinHash signature and then ranked by exact Jaccard similarity,
+	 * so recipes sharing less than about half their ingredients may be missed.
+	 *
+	 * @param id ID of the recipe to compare against.
+	 * @param count Maximum number of recipes to return.
+	 *
+	 * @return Recipes with their similarity, most similar first.
+	 */
+	std::vector<struct scored_recipe> get_similar_recipes(const int id, const int count);
+	/**
+	 * @brief Get the ingredient IDs of every recipe in a single query.
+	 *
+	 * @return Sorted ingredient IDs by recipe ID.
+	 */
+	std::map<int, std::vector<int>> get_all_recipe_ingredient_ids(void);
+	/**
+	 * @brief Get the groups of recipes sharing an LSH bucket of their
+	 * ingredient signatures. Only buckets of two or more recipes are returned.
+	 */
+	std::vector<std::vector<int>> get_ingredient_buckets(void);
+	/**
+	 * @brief Merge recipes into another in a single transaction. The
+	 * ingredients and tags of the merged recipes are moved to the survivor
+	 * (unless it already has them), as are their attachments (renamed if the
+	 * name is taken) and cooking history, and the merged recipes deleted.
+	 *
+	 * @param survivor ID of the recipe to keep.
+	 * @param ids IDs of the recipes to merge into survivor.
+	 */
+	void merge_recipes(const int survivor, const std::vector<int> &ids);
+	/**
+	 * @brief Add many recipes in a single transaction. Ingredients and tags
+	 * are resolved through caches of IDs by lower-cased name, which are filled
+	 * with those of the database when empty and are meant to be kept across
+	 * calls. Recipes with a replace_id overwrite that recipe; others whose
+	 * name is already taken are skipped.
+	 *
+	 * @param recipes Recipes to add.
+	 * @param ingredient_ids Cache of ingredient IDs.
+	 * @param tag_ids Cache of tag IDs.
+	 *
+	 * @return Number of recipes added or overwritten.
+	 */
+	int import_recipes(const std::vector<struct recipe_import> &recipes,
+					   std::unordered_map<std::string, int> &ingredient_ids,
+					   std::unordered_map<std::string, int> &tag_ids);
+	/**
+	 * @brief Get the content hash of every recipe, computing those of recipes
+	 * modified since they were last asked for.
+	 *
+	 * @return The hashes, sorted by key.
+	 */
+	std::vector<struct recipe_hash> get_recipe_hashes(void);
 
 	/**
 	 * @brief Add a new ingredient to the database.
@@ -72,13 +307,72 @@ public:
 	 * @return ID of newly created ingredient.
 	 */
 	int add_ingredient(const std::string &name);
-	std::vector<std::string> get_recipe_ingredients(const int id);
+	name_set get_recipe_ingredients(const int id);
+	std::vector<struct ingredient_amount> get_recipe_ingredient_amounts(const int id);
+	/**
+	 * @brief Get the units known to the database, by name.
+	 */
+	std::map<std::string, struct unit> get_units(void);
+	/**
+	 * @brief Total the ingredients of several recipes in a single grouped
+	 * query. Amounts in known units are converted to their base unit (grams
+	 * or millilitres) before being added up.
+	 *
+	 * @param recipe_ids IDs of the recipes, which may be repeated to count
+	 * them more than once.
+	 *
+	 * @return Totals per ingredient and unit, sorted by ingredient name.
+	 */
+	std::vector<struct ingredient_amount> get_shopping_list(const std::vector<int> &recipe_ids);
+
+	/**
+	 * @brief Set the nutrients of an ingredient.
+	 *
+	 * @param ingredient_id ID of the ingredient.
+	 * @param unit Base unit the values refer to (g, ml, or empty for a unit).
+	 * @param values Nutrients in one unit of the ingredient.
+	 */
+	void set_ingredient_nutrition(const int ingredient_id, const std::string &unit, const nutrient_vec &values);
+	/**
+	 * @brief Get the nutrient totals of recipes. Totals are cached per recipe
+	 * and only recomputed, in a single batch, for recipes whose ingredients
+	 * (or their nutrients) changed since.
+	 *
+	 * @return Nutrients by recipe ID, along with how many of the recipe's
+	 * ingredients they account for.
+	 */
+	std::map<int, struct recipe_nutrition> get_recipe_nutrition(const std::vector<int> &ids);
 	inline int get_ingredient_id(const std::string &name) {
 		return table_get_id_by_name("ingredients", name);
 	}
 	inline bool ingredient_exists(const std::string &name) {
 		return (get_ingredient_id(name) > 0);
 	}
+	/**
+	 * @brief Replace ingredients by another across all recipes, in a single
+	 * transaction, deleting the replaced ingredients.
+	 *
+	 * @param ids IDs of the ingredients to replace.
+	 * @param into ID of the ingredient replacing them.
+	 */
+	void merge_ingredients(const std::vector<int> &ids, const int into);
+	void rename_ingredient(const int id, const std::string &new_name);
+	/**
+	 * @brief Record that an ingredient can be replaced by another. The
+	 * transitive closure of substitutes is extended accordingly, so that
+	 * filters can expand an ingredient with a single indexed lookup.
+	 *
+	 * @param ingredient_id ID of the ingredient to replace.
+	 * @param substitute_id ID of the ingredient that can replace it.
+	 * @param weight How good of a replacement it is.
+	 */
+	void add_substitute(const int ingredient_id, const int substitute_id, const double weight = 1);
+	void del_substitute(const int ingredient_id, const int substitute_id);
+	/**
+	 * @brief Get the names of all ingredients that can replace another,
+	 * directly or through other substitutes.
+	 */
+	std::vector<std::string> get_substitutes(const int ingredient_id);
 
 	/**
 	 * @brief Add a new tag to the database.
@@ -88,16 +382,153 @@ public:
 	 * @return ID of newly created tag, -1 if DB isn't open, -2 on other failure.
 	 */
 	int add_tag(const std::string &name);
-	std::vector<std::string> get_recipe_tags(const int id);
+	name_set get_recipe_tags(const int id);
 	inline int get_tag_id(const std::string &name) {
 		return table_get_id_by_name("tags", name);
 	}
 	inline bool tag_exists(const std::string &name) {
 		return (get_tag_id(name) > 0);
 	}
+	/**
+	 * @brief Replace tags by another across all recipes, in a single
+	 * transaction, deleting the replaced tags.
+	 *
+	 * @param ids IDs of the tags to replace.
+	 * @param into ID of the tag replacing them.
+	 */
+	void merge_tags(const std::vector<int> &ids, const int into);
+	/**
+	 * @brief Place a tag (along with its descendants) under another, so that
+	 * filtering by the latter matches recipes with the former too.
+	 *
+	 * @param id ID of the tag to move.
+	 * @param parent_id ID of its new parent, 0 to make it a top-level tag.
+	 */
+	void set_tag_parent(const int id, const int parent_id);
+	/**
+	 * @brief Get all tags with their parents, ordered by name.
+	 */
+	std::vector<struct tag_node> get_tag_tree(void);
 
 	void conn_recipe_ingredient(const int recipe_id, const int ingredient_id);
 	void disconn_recipe_ingredient(const int recipe_id, const int ingredient_id);
 	void conn_recipe_tag(const int recipe_id, const int tag_id);
 	void disconn_recipe_tag(const int recipe_id, const int tag_id);
+	/*
+	 * Set-based versions of the above, linking or unlinking every given
+	 * recipe with every given ingredient/tag in a single statement. Linking
+	 * ingredients may also set their amounts (those with a quantity), given
+	 * in the same order as their IDs, within the same transaction.
+	 */
+	void conn_recipes_ingredients(const std::vector<int> &recipe_ids, const std::vector<int> &ingredient_ids,
+								  const std::vector<struct ingredient_amount> &amounts = {});
+	void disconn_recipes_ingredients(const std::vector<int> &recipe_ids, const std::vector<int> &ingredient_ids);
+	void conn_recipes_tags(const std::vector<int> &recipe_ids, const std::vector<int> &tag_ids);
+	void disconn_recipes_tags(const std::vector<int> &recipe_ids, const std::vector<int> &tag_ids);
+
+	/**
+	 * @brief Record that a recipe was cooked, updating its cooking score.
+	 *
+	 * @param recipe_id ID of the recipe cooked.
+	 * @param when Time at which it was cooked.
+	 */
+	void add_cooked(const int recipe_id, const time_t when);
+	/**
+	 * @brief Get the cooking score of recipes that have been cooked. Each meal
+	 * adds one to the score of its recipe, halving every two weeks.
+	 *
+	 * @param now Time at which to evaluate the scores.
+	 *
+	 * @return Scores by recipe ID.
+	 */
+	std::map<int, double> get_recipe_scores(const time_t now);
+
+	/**
+	 * @brief Store a file attached to a recipe. The data is streamed into the
+	 * database in fixed-size chunks, so it is never held in memory at once.
+	 *
+	 * @param recipe_id ID of the recipe to attach the data to.
+	 * @param name Name of the attachment (unique per recipe).
+	 * @param data Stream from which the contents are read.
+	 * @param size Number of bytes to read from data.
+	 *
+	 * @return ID of newly created attachment.
+	 */
+	int add_attachment(const int recipe_id, const std::string &name,
+					   std::istream &data, const sqlite3_int64 size);
+	/**
+	 * @brief List the attachments of a recipe without reading their contents.
+	 */
+	std::vector<struct attachment> get_recipe_attachments(const int recipe_id);
+	/**
+	 * @brief Write the contents of an attachment to a stream, chunk by chunk.
+	 *
+	 * @return false if the recipe has no attachment with that name.
+	 */
+	bool read_attachment(const int recipe_id, const std::string &name, std::ostream &out);
+
+	/**
+	 * @brief Copy the database to a file while it stays available to other
+	 * readers and writers, a number of pages at a time with a pause between
+	 * steps. Changes made by others during the backup make it start over.
+	 *
+	 * @param dest Path of the copy, overwritten if it exists.
+	 * @param pages_per_step Pages copied in each step.
+	 * @param progress Called after each step with the pages left and in total.
+	 */
+	void backup(const std::string &dest, const int pages_per_step,
+				const std::function<void(int, int)> &progress);
+	/**
+	 * @brief Check the integrity of a database file.
+	 *
+	 * @return The problems found, none if it's fine.
+	 */
+	static std::vector<std::string> check_integrity(const std::string &path);
+
+	/**
+	 * @brief Get the recipes that changed after a point of the change log,
+	 * which triggers keep for every change to recipes and their ingredients
+	 * and tags, whoever makes it.
+	 *
+	 * @param since Sequence number of the last change already seen (0 for
+	 * all).
+	 * @param changed IDs of the recipes added or modified since, which still
+	 * exist.
+	 * @param deleted IDs of the recipes deleted since.
+	 *
+	 * @return Sequence number of the last change.
+	 */
+	int get_changes(const int since, std::vector<int> &changed, std::vector<int> &deleted);
+
+	/**
+	 * @brief Get the number of recipes using some ingredients or tags, from
+	 * the counters triggers keep. Tags count the recipes of their descendants
+	 * as well, so a recipe with several of them counts more than once.
+	 *
+	 * @param kind NAMES_INGREDIENTS or NAMES_TAGS.
+	 * @param ids IDs of the ingredients or tags.
+	 */
+	std::map<int, int> get_recipe_counts(const enum name_kind kind, const std::vector<int> &ids);
+	/**
+	 * @brief Get the ingredients or tags used by the most recipes.
+	 *
+	 * @param kind NAMES_INGREDIENTS or NAMES_TAGS.
+	 * @param count Maximum number of them to get.
+	 */
+	std::vector<struct name_count> get_top_names(const enum name_kind kind, const int count);
+	/**
+	 * @brief Get the recipes with each ingredient or tag, so that they can be
+	 * filtered without querying the database again.
+	 *
+	 * @param kind NAMES_INGREDIENTS or NAMES_TAGS. Tags include the recipes
+	 * of their descendants.
+	 *
+	 * @return The sorted IDs of the recipes, by lower-cased name.
+	 */
+	std::map<std::string, std::vector<int>> get_recipes_by_name(const enum name_kind kind);
+	/**
+	 * @brief Get the size of the catalog and the distribution of ingredients
+	 * per recipe, from the counters triggers keep.
+	 */
+	struct catalog_stats get_catalog_stats(void);
 };
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "dedupe.hpp"
+#include "minhash.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * Buckets larger than this (e.g. a band shared by every recipe called "<x>
+ * soup") are ignored, as they would produce a quadratic number of pairs
+ * without telling much apart.
+ */
+#define DEDUPE_MAX_BUCKET 256
+
+/*
+ * Call f(i, t) for every i in [0, n), spread over all available cores, where t
+ * is the index of the thread running the call.
+ */
+template<typename F>
+static void parallel_for(const size_t n, F f) {
+	const size_t thread_num = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads;
+
+	for(size_t t = 0; t < thread_num; ++t) {
+		threads.emplace_back([&, t]() {
+							 for(size_t i = t; i < n; i += thread_num)
+								 f(i, t);
+							 });
+	}
+
+	for(auto &thread : threads)
+		thread.join();
+}
+
+/*
+ * Hashes of the character trigrams of a name, once lower-cased and with any
+ * punctuation or repeated whitespace collapsed into a single space.
+ */
+static std::vector<int> name_shingles(const std::string_view name) {
+	std::string norm = " ";
+	std::vector<int> shingles;
+
+	for(unsigned char c : name) {
+		if(std::isalnum(c))
+			norm += static_cast<char>(std::tolower(c));
+		else if(norm.back() not_eq ' ')
+			norm += ' ';
+	}
+	if(norm.back() not_eq ' ')
+		norm += ' ';
+
+	for(size_t i = 0; i + 3 <= norm.size(); ++i)
+		shingles.push_back(static_cast<int>(std::hash<std::string_view>{}(std::string_view(norm).substr(i, 3))));
+
+	std::sort(shingles.begin(), shingles.end());
+	shingles.erase(std::unique(shingles.begin(), shingles.end()), shingles.end());
+
+	return shingles;
+}
+
+static size_t find_root(std::vector<size_t> &parent, size_t i) {
+	while(parent[i] not_eq i)
+		i = parent[i] = parent[parent[i]];
+	return i;
+}
+
+std::vector<std::vector<int>> find_duplicates(const recipe_set &recipes,
+											  const std::map<int, std::vector<int>> &ingredients,
+											  const std::vector<std::vector<int>> &ingr_buckets,
+											  const double threshold)
+{
+	const size_t thread_num = std::max(1u, std::thread::hardware_concurrency());
+	const std::vector<int> no_ingredients;
+	std::vector<std::vector<int>> shingles(recipes.size());
+	std::vector<minhash_sig> sigs(recipes.size());
+	std::vector<const std::vector<int>*> recipe_ingredients(recipes.size(), &no_ingredients);
+	std::unordered_map<int, size_t> index;
+	std::unordered_map<int64_t, std::vector<size_t>> name_buckets;
+	std::vector<std::pair<size_t, size_t>> pairs;
+	std::vector<std::vector<std::pair<size_t, size_t>>> matches(thread_num);
+	std::vector<size_t> parent(recipes.size());
+	std::map<size_t, std::vector<int>> clusters;
+	std::vector<std::vector<int>> result;
+
+	for(size_t i = 0; i < recipes.size(); ++i) {
+		const auto ingr = ingredients.find(recipes[i].id);
+
+		index[recipes[i].id] = i;
+		if(ingr not_eq ingredients.end())
+			recipe_ingredients[i] = &ingr->second;
+	}
+
+	parallel_for(recipes.size(), [&](size_t i, size_t) {
+				 shingles[i] = name_shingles(recipes[i].name);
+				 sigs[i] = minhash_signature(shingles[i]);
+				 });
+
+	for(size_t i = 0; i < recipes.size(); ++i) {
+		if(shingles[i].empty())
+			continue;
+		for(int band = 0; band < LSH_BANDS; ++band)
+			name_buckets[lsh_bucket(sigs[i], band)].push_back(i);
+	}
+
+	auto add_pairs = [&](const std::vector<size_t> &bucket) {
+		if(bucket.size() > DEDUPE_MAX_BUCKET)
+			return;
+		for(size_t a = 0; a < bucket.size(); ++a) {
+			for(size_t b = a + 1; b < bucket.size(); ++b)
+				pairs.push_back(std::minmax(bucket[a], bucket[b]));
+		}
+	};
+
+	for(const auto &bucket : name_buckets)
+		add_pairs(bucket.second);
+
+	for(const auto &bucket : ingr_buckets) {
+		std::vector<size_t> members;
+
+		for(auto id : bucket) {
+			const auto i = index.find(id);
+			if(i not_eq index.end())
+				members.push_back(i->second);
+		}
+		add_pairs(members);
+	}
+
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+	parallel_for(pairs.size(), [&](size_t i, size_t t) {
+				 const auto [a, b] = pairs[i];
+				 const double name_sim = jaccard(shingles[a], shingles[b]);
+				 double sim = name_sim;
+
+				 if(not recipe_ingredients[a]->empty() or not recipe_ingredients[b]->empty())
+					 sim = (name_sim + jaccard(*recipe_ingredients[a], *recipe_ingredients[b])) / 2;
+
+				 if(sim >= threshold)
+					 matches[t].push_back(pairs[i]);
+				 });
+
+	for(size_t i = 0; i < parent.size(); ++i)
+		parent[i] = i;
+
+	for(const auto &thread_matches : matches) {
+		for(const auto &[a, b] : thread_matches)
+			parent[find_root(parent, a)] = find_root(parent, b);
+	}
+
+	for(size_t i = 0; i < recipes.size(); ++i)
+		clusters[find_root(parent, i)].push_back(recipes[i].id);
+
+	for(auto &cluster : clusters) {
+		if(cluster.second.size() < 2)
+			continue;
+		std::sort(cluster.second.begin(), cluster.second.end());
+		result.push_back(std::move(cluster.second));
+	}
+	std::sort(result.begin(), result.end());
+
+	return result;
+}
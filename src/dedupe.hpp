@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "db.hpp"
+
+#include <map>
+#include <vector>
+
+/**
+ * @brief Find clusters of recipes which are likely duplicates of each other.
+ * Candidate pairs are those that share an LSH bucket on either the shingles of
+ * their normalized names or their ingredients; each candidate pair is then
+ * scored as the mean of both exact Jaccard similarities, and pairs reaching the
+ * threshold are joined into clusters. Scoring is spread over all cores.
+ *
+ * @param recipes Recipes of the catalog.
+ * @param ingredients Sorted ingredient IDs of each recipe, by recipe ID.
+ * @param ingr_buckets Recipe IDs sharing an ingredient LSH bucket.
+ * @param threshold Minimum similarity, between 0 and 1, of two duplicates.
+ *
+ * @return Clusters of recipe IDs, each sorted and of at least two recipes.
+ */
+std::vector<std::vector<int>> find_duplicates(const recipe_set &recipes,
+											  const std::map<int, std::vector<int>> &ingredients,
+											  const std::vector<std::vector<int>> &ingr_buckets,
+											  const double threshold);
@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "jsonld.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <stdexcept>
+
+/*
+ * Deepest nesting of JSON values accepted, so that malicious pages can't
+ * overflow the stack.
+ */
+#define JSON_MAX_DEPTH 256
+
+struct json_value {
+	enum { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT } type = JSON_NULL;
+	// contents of strings, and numbers and booleans as written
+	std::string str;
+	// elements of arrays, and values of objects
+	std::vector<json_value> items;
+	// keys of objects, matching items
+	std::vector<std::string> keys;
+
+	const json_value *get(const std::string_view key) const {
+		for(size_t i = 0; i < keys.size(); ++i) {
+			if(keys[i] == key)
+				return &items[i];
+		}
+		return nullptr;
+	}
+};
+
+static void append_utf8(std::string &str, uint32_t cp) {
+	if(cp < 0x80) {
+		str += static_cast<char>(cp);
+	} else if(cp < 0x800) {
+		str += static_cast<char>(0xc0 | (cp >> 6));
+		str += static_cast<char>(0x80 | (cp & 0x3f));
+	} else if(cp < 0x10000) {
+		str += static_cast<char>(0xe0 | (cp >> 12));
+		str += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+		str += static_cast<char>(0x80 | (cp & 0x3f));
+	} else {
+		str += static_cast<char>(0xf0 | (cp >> 18));
+		str += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+		str += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+		str += static_cast<char>(0x80 | (cp & 0x3f));
+	}
+}
+
+/*
+ * A recursive descent JSON parser. It's lenient in the ways pages commonly
+ * break the standard: control characters within strings and trailing commas
+ * are accepted.
+ */
+class json_parser {
+private:
+	std::string_view text;
+	size_t pos;
+
+	[[noreturn]] void fail(const char *what) {
+		throw std::runtime_error(std::format("Malformed JSON-LD at offset {}: {}.", pos, what));
+	}
+
+	void skip_ws(void) {
+		while(pos < text.size() and std::isspace(static_cast<unsigned char>(text[pos])))
+			++pos;
+	}
+
+	bool consume(const char c) {
+		skip_ws();
+		if(pos < text.size() and text[pos] == c) {
+			++pos;
+			return true;
+		}
+		return false;
+	}
+
+	uint32_t parse_hex4(void) {
+		uint32_t value = 0;
+
+		if(pos + 4 > text.size())
+			fail("truncated escape");
+		for(int i = 0; i < 4; ++i) {
+			const char c = text[pos++];
+			value <<= 4;
+			if(c >= '0' and c <= '9')
+				value |= c - '0';
+			else if(c >= 'a' and c <= 'f')
+				value |= c - 'a' + 10;
+			else if(c >= 'A' and c <= 'F')
+				value |= c - 'A' + 10;
+			else
+				fail("invalid escape");
+		}
+
+		return value;
+	}
+
+	std::string parse_string(void) {
+		std::string str;
+
+		if(not consume('"'))
+			fail("expected string");
+
+		while(true) {
+			const size_t end = text.find_first_of("\"\\", pos);
+
+			if(end == std::string_view::npos)
+				fail("unterminated string");
+			str.append(text.substr(pos, end - pos));
+			pos = end + 1;
+			if(text[end] == '"')
+				break;
+
+			if(pos >= text.size())
+				fail("unterminated string");
+			switch(text[pos++]) {
+			case 'b': str += '\b'; break;
+			case 'f': str += '\f'; break;
+			case 'n': str += '\n'; break;
+			case 'r': str += '\r'; break;
+			case 't': str += '\t'; break;
+			case 'u': {
+				uint32_t cp = parse_hex4();
+
+				if(cp >= 0xd800 and cp < 0xdc00 and text.substr(pos, 2) == "\\u") {
+					pos += 2;
+					const uint32_t low = parse_hex4();
+					cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+				}
+				append_utf8(str, cp);
+				break;
+			}
+			default: str += text[pos - 1]; break;
+			}
+		}
+
+		return str;
+	}
+
+	json_value parse_value(const int depth) {
+		json_value value;
+
+		if(depth > JSON_MAX_DEPTH)
+			fail("nested too deeply");
+
+		skip_ws();
+		if(pos >= text.size())
+			fail("unexpected end");
+
+		switch(text[pos]) {
+		case '{':
+			++pos;
+			value.type = json_value::JSON_OBJECT;
+			while(not consume('}')) {
+				value.keys.push_back(parse_string());
+				if(not consume(':'))
+					fail("expected ':'");
+				value.items.push_back(parse_value(depth + 1));
+				if(not consume(',') and not (skip_ws(), pos < text.size() and text[pos] == '}'))
+					fail("expected ',' or '}'");
+			}
+			break;
+		case '[':
+			++pos;
+			value.type = json_value::JSON_ARRAY;
+			while(not consume(']')) {
+				value.items.push_back(parse_value(depth + 1));
+				if(not consume(',') and not (skip_ws(), pos < text.size() and text[pos] == ']'))
+					fail("expected ',' or ']'");
+			}
+			break;
+		case '"':
+			value.type = json_value::JSON_STRING;
+			value.str = parse_string();
+			break;
+		default: {
+			const size_t end = std::min(text.find_first_of(",]} \t\r\n", pos), text.size());
+
+			value.str = text.substr(pos, end - pos);
+			pos = end;
+			if(value.str == "null")
+				value.type = json_value::JSON_NULL;
+			else if(value.str == "true" or value.str == "false")
+				value.type = json_value::JSON_BOOL;
+			else if(value.str.find_first_not_of("+-0123456789.eE") == std::string::npos and not value.str.empty())
+				value.type = json_value::JSON_NUMBER;
+			else
+				fail("unexpected token");
+			break;
+		}
+		}
+
+		return value;
+	}
+
+public:
+	json_parser(const std::string_view text) : text(text), pos(0) {}
+
+	json_value parse(void) {
+		json_value value = parse_value(0);
+
+		skip_ws();
+		// pages sometimes end their scripts with a stray semicolon
+		if(pos < text.size() and text[pos] == ';')
+			++pos;
+		skip_ws();
+		if(pos not_eq text.size())
+			fail("trailing data");
+
+		return value;
+	}
+};
+
+/*
+ * Decode the HTML entities and drop the tags that some sites leave in their
+ * JSON-LD strings, and collapse whitespace.
+ */
+static std::string clean_text(const std::string_view str) {
+	static const std::pair<std::string_view, uint32_t> entities[] = {
+		{ "amp", '&' }, { "lt", '<' }, { "gt", '>' }, { "quot", '"' },
+		{ "apos", '\'' }, { "nbsp", ' ' }, { "frac12", 0xbd }, { "frac14", 0xbc },
+		{ "frac34", 0xbe }, { "deg", 0xb0 },
+	};
+	std::string clean;
+	bool space = false;
+
+	clean.reserve(str.size());
+	for(size_t i = 0; i < str.size(); ++i) {
+		char c = str[i];
+
+		if(c == '<') {
+			const size_t end = str.find('>', i);
+
+			if(end not_eq std::string_view::npos) {
+				i = end;
+				space = true;
+				continue;
+			}
+		} else if(c == '&') {
+			const size_t end = str.find(';', i);
+
+			if(end not_eq std::string_view::npos and end - i <= 10) {
+				const std::string_view name = str.substr(i + 1, end - i - 1);
+				uint32_t cp = 0;
+
+				if(name.size() > 1 and name[0] == '#') {
+					cp = name[1] == 'x' or name[1] == 'X' ?
+						std::strtoul(std::string(name.substr(2)).c_str(), nullptr, 16) :
+						std::strtoul(std::string(name.substr(1)).c_str(), nullptr, 10);
+				} else {
+					for(const auto &entity : entities) {
+						if(entity.first == name)
+							cp = entity.second;
+					}
+				}
+
+				if(cp > 0 and cp <= 0x10ffff) {
+					if(space and not clean.empty())
+						clean += ' ';
+					space = false;
+					if(cp == ' ' or cp == 0xa0)
+						space = true;
+					else
+						append_utf8(clean, cp);
+					i = end;
+					continue;
+				}
+			}
+		}
+
+		if(std::isspace(static_cast<unsigned char>(c))) {
+			space = true;
+			continue;
+		}
+		if(space and not clean.empty())
+			clean += ' ';
+		space = false;
+		clean += c;
+	}
+
+	return clean;
+}
+
+static bool is_recipe(const json_value &object) {
+	const json_value *type = object.get("@type");
+
+	if(not type)
+		return false;
+
+	auto is_recipe_type = [](const json_value &value) {
+		// plain, or with the vocabulary's URL before it
+		return value.type == json_value::JSON_STRING and
+			(value.str == "Recipe" or value.str.ends_with("/Recipe"));
+	};
+
+	if(type->type == json_value::JSON_ARRAY)
+		return std::any_of(type->items.begin(), type->items.end(), is_recipe_type);
+	return is_recipe_type(*type);
+}
+
+/*
+ * Strings of a property, which may be a single string or a list of them.
+ */
+static std::vector<std::string> get_strings(const json_value &object, const std::string_view key) {
+	const json_value *value = object.get(key);
+	std::vector<std::string> strings;
+
+	if(not value)
+		return strings;
+
+	if(value->type == json_value::JSON_STRING) {
+		strings.push_back(clean_text(value->str));
+	} else if(value->type == json_value::JSON_ARRAY) {
+		for(const auto &item : value->items) {
+			if(item.type == json_value::JSON_STRING)
+				strings.push_back(clean_text(item.str));
+		}
+	}
+
+	std::erase_if(strings, [](const std::string &str) { return str.empty(); });
+
+	return strings;
+}
+
+static void find_recipes(const json_value &value, std::vector<struct ld_recipe> &recipes) {
+	if(value.type == json_value::JSON_OBJECT and is_recipe(value)) {
+		struct ld_recipe recipe;
+		std::vector<std::string> strings;
+
+		if(not (strings = get_strings(value, "name")).empty())
+			recipe.name = strings[0];
+		if(not (strings = get_strings(value, "description")).empty())
+			recipe.description = strings[0];
+		recipe.ingredients = get_strings(value, "recipeIngredient");
+		// older pages use the deprecated property
+		if(recipe.ingredients.empty())
+			recipe.ingredients = get_strings(value, "ingredients");
+
+		for(const auto &keywords : get_strings(value, "keywords")) {
+			for(auto &keyword : split(keywords, ",")) {
+				trim(keyword);
+				if(not keyword.empty())
+					recipe.keywords.push_back(keyword);
+			}
+		}
+
+		if(not recipe.name.empty())
+			recipes.push_back(std::move(recipe));
+		return;
+	}
+
+	for(const auto &item : value.items)
+		find_recipes(item, recipes);
+}
+
+/*
+ * Case-insensitive search, as HTML doesn't care about the case of tags and
+ * attributes.
+ */
+static size_t find_nocase(const std::string_view text, const std::string_view needle, const size_t pos) {
+	const auto it = std::search(text.begin() + std::min(pos, text.size()), text.end(),
+								needle.begin(), needle.end(),
+								[](const char a, const char b) {
+								return std::tolower(static_cast<unsigned char>(a)) == b;
+								});
+
+	return it == text.end() ? std::string_view::npos : it - text.begin();
+}
+
+std::vector<struct ld_recipe> extract_ld_recipes(const std::string_view text, const bool html) {
+	std::vector<struct ld_recipe> recipes;
+	// first error in a block, only reported if none could be parsed
+	std::optional<std::runtime_error> error;
+	bool parsed = false;
+
+	if(not html) {
+		find_recipes(json_parser(text).parse(), recipes);
+		return recipes;
+	}
+
+	for(size_t pos = 0; (pos = find_nocase(text, "application/ld+json", pos)) not_eq std::string_view::npos;) {
+		const size_t start = text.find('>', pos);
+		size_t end;
+
+		if(start == std::string_view::npos or
+		   (end = find_nocase(text, "</script", start)) == std::string_view::npos)
+			break;
+
+		std::string_view script = text.substr(start + 1, end - start - 1);
+		// some sites hide their scripts from ancient browsers
+		const size_t first = script.find_first_not_of(" \t\r\n");
+		if(first not_eq std::string_view::npos and script.substr(first).starts_with("<!--")) {
+			script.remove_prefix(first + 4);
+			if(const size_t last = script.rfind("-->"); last not_eq std::string_view::npos)
+				script = script.substr(0, last);
+		}
+
+		if(script.find_first_not_of(" \t\r\n") not_eq std::string_view::npos) {
+			// a broken block (often not even a recipe) shouldn't lose the others on the page
+			try {
+				find_recipes(json_parser(script).parse(), recipes);
+				parsed = true;
+			} catch(const std::runtime_error &e) {
+				if(not error)
+					error = e;
+			}
+		}
+		pos = end;
+	}
+
+	if(error and not parsed)
+		throw *error;
+
+	return recipes;
+}
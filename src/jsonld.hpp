@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ld_recipe {
+	std::string name;
+	std::string description;
+	std::vector<std::string> ingredients;
+	std::vector<std::string> keywords;
+};
+
+/**
+ * @brief Extract the schema.org Recipe objects of a JSON-LD document, or of
+ * the JSON-LD scripts of an HTML page. Recipes are found at any depth (e.g.
+ * within an "@graph"), and HTML entities left in their strings are decoded.
+ *
+ * @param text Contents of the document.
+ * @param html Whether the document is an HTML page rather than JSON-LD.
+ *
+ * @return The recipes found, with their name, description, ingredient lines
+ * and keywords (which may come as a comma-separated string or a list).
+ *
+ * @throws std::runtime_error if the JSON-LD is malformed, or for pages, if all
+ * of their JSON-LD blocks are.
+ */
+std::vector<struct ld_recipe> extract_ld_recipes(std::string_view text, const bool html);
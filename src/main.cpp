@@ -49,14 +49,12 @@ int main(int argc, char *argv[]) {
 			ret = cmd_delete(argc - 2, argv + 2);
 			break;
 		case CMD_LIST:
-			if(argc > 6)
-				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
 			ret = cmd_list(argc - 1, argv + 1);
 			break;
 		case CMD_INFO:
-			if(argc not_eq 3)
+			if(argc < 3)
 				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
-			ret = cmd_info(std::stoi(argv[2]));
+			ret = cmd_info(argc - 1, argv + 1);
 			break;
 		case CMD_EDIT_NAME:
 			if(argc not_eq 3)
@@ -69,24 +67,144 @@ int main(int argc, char *argv[]) {
 			ret = cmd_edit_desc(std::stoi(argv[2]));
 			break;
 		case CMD_ADD_INGR:
-			if(argc not_eq 4)
+			if(argc < 4 or argc > 7)
 				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
-			ret = cmd_add_ingr(std::stoi(argv[2]), argv[3]);
+			ret = cmd_add_ingr(argc - 1, argv + 1);
 			break;
 		case CMD_RM_INGR:
-			if(argc not_eq 4)
+			if(argc < 4 or argc > 7)
 				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
-			ret = cmd_rm_ingr(std::stoi(argv[2]), argv[3]);
+			ret = cmd_rm_ingr(argc - 1, argv + 1);
 			break;
 		case CMD_ADD_TAG:
-			if(argc not_eq 4)
+			if(argc < 4 or argc > 7)
 				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
-			ret = cmd_add_tag(std::stoi(argv[2]), argv[3]);
+			ret = cmd_add_tag(argc - 1, argv + 1);
 			break;
 		case CMD_RM_TAG:
+			if(argc < 4 or argc > 7)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_rm_tag(argc - 1, argv + 1);
+			break;
+		case CMD_MERGE_INGR:
+			if(argc not_eq 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_merge_ingr(argv[2], argv[3]);
+			break;
+		case CMD_MERGE_TAG:
+			if(argc not_eq 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_merge_tag(argv[2], argv[3]);
+			break;
+		case CMD_MOVE_TAG:
+			if(argc < 3 or argc > 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_move_tag(argv[2], argc == 4 ? argv[3] : "");
+			break;
+		case CMD_TAGS:
+			if(argc not_eq 2)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_tags();
+			break;
+		case CMD_RENAME_INGR:
+			if(argc not_eq 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_rename_ingr(argv[2], argv[3]);
+			break;
+		case CMD_ADD_SUB:
+			if(argc < 4 or argc > 5)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_add_sub(argv[2], argv[3], argc == 5 ? argv[4] : nullptr);
+			break;
+		case CMD_RM_SUB:
+			if(argc not_eq 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_rm_sub(argv[2], argv[3]);
+			break;
+		case CMD_SUBS:
+			if(argc not_eq 3)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_subs(argv[2]);
+			break;
+		case CMD_ATTACH:
+			if(argc not_eq 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_attach(std::stoi(argv[2]), argv[3]);
+			break;
+		case CMD_ATTACHMENT:
 			if(argc not_eq 4)
 				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
-			ret = cmd_rm_tag(std::stoi(argv[2]), argv[3]);
+			ret = cmd_attachment(std::stoi(argv[2]), argv[3]);
+			break;
+		case CMD_SUGGEST:
+			if(argc > 8)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_suggest(argc - 1, argv + 1);
+			break;
+		case CMD_COOKED:
+			if(argc not_eq 3)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_cooked(std::stoi(argv[2]));
+			break;
+		case CMD_SHOPPING_LIST:
+			if(argc < 3)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_shopping_list(argc - 2, argv + 2);
+			break;
+		case CMD_NUTRITION:
+			if(argc < 3)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_nutrition(argc - 2, argv + 2);
+			break;
+		case CMD_SET_NUTRITION:
+			if(argc not_eq 5)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_set_nutrition(argv[2], argv[3], argv[4]);
+			break;
+		case CMD_SIMILAR:
+			if(argc < 3 or argc > 5)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_similar(argc - 1, argv + 1);
+			break;
+		case CMD_DEDUPE:
+			if(argc > 5)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_dedupe(argc - 1, argv + 1);
+			break;
+		case CMD_COMPLETE:
+			if(argc < 3 or argc > 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_complete(argv[2], argc == 4 ? argv[3] : "");
+			break;
+		case CMD_INGEST:
+			if(argc not_eq 3)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_ingest(argv[2]);
+			break;
+		case CMD_BACKUP:
+			if(argc < 3 or argc > 6)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_backup(argc - 1, argv + 1);
+			break;
+		case CMD_EXPORT:
+			if(argc > 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_export(argc - 1, argv + 1);
+			break;
+		case CMD_SYNC:
+			if(argc not_eq 3)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_sync(argv[2]);
+			break;
+		case CMD_STATS:
+			if(argc > 4)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_stats(argc - 1, argv + 1);
+			break;
+		case CMD_BROWSE:
+			if(argc not_eq 2)
+				throw "Invalid number of arguments. Use 'help' subcommand for more information.";
+			ret = cmd_browse();
 			break;
 		case CMD_HELP:
 			if(argc not_eq 2)
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "merkle.hpp"
+
+#include <algorithm>
+#include <array>
+
+// children of each node, which take the next 4 bits of the key
+#define MERKLE_FANOUT 16
+#define MERKLE_FANOUT_BITS 4
+// ranges with at most this many leaves aren't split any further
+#define MERKLE_LEAF_SZ 8
+
+struct merkle_node {
+	uint64_t hash;
+	// leaves covered by the node
+	size_t begin, end;
+	// indexes of the child nodes, -1 for empty ranges; all -1 in leaf nodes
+	std::array<int, MERKLE_FANOUT> children;
+};
+
+static uint64_t mix(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static uint64_t hash_combine(const uint64_t seed, const uint64_t value) {
+	return mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+uint64_t hash_string(const std::string_view str) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for(const char c : str) {
+		h ^= static_cast<unsigned char>(c);
+		h *= 0x100000001b3ULL;
+	}
+
+	return mix(h);
+}
+
+/*
+ * Build the node of leaves [begin, end), whose keys share their first
+ * `depth` digits, and its descendants. Returns the index of the node.
+ */
+static int build_node(const std::vector<struct merkle_leaf> &leaves, const size_t begin, const size_t end,
+					  const int depth, std::vector<struct merkle_node> &nodes) {
+	const int index = nodes.size();
+	struct merkle_node node;
+	uint64_t hash = 0;
+
+	node.begin = begin;
+	node.end = end;
+	node.children.fill(-1);
+	nodes.push_back(node);
+
+	if(end - begin <= MERKLE_LEAF_SZ or depth * MERKLE_FANOUT_BITS >= 64) {
+		for(size_t i = begin; i < end; ++i)
+			hash = hash_combine(hash_combine(hash, leaves[i].key), leaves[i].hash);
+	} else {
+		const int shift = 64 - (depth + 1) * MERKLE_FANOUT_BITS;
+
+		for(size_t i = begin; i < end;) {
+			const int digit = (leaves[i].key >> shift) & (MERKLE_FANOUT - 1);
+			size_t j = i;
+
+			while(j < end and static_cast<int>((leaves[j].key >> shift) & (MERKLE_FANOUT - 1)) == digit)
+				++j;
+
+			const int child = build_node(leaves, i, j, depth + 1, nodes);
+			nodes[index].children[digit] = child;
+			hash = hash_combine(hash_combine(hash, digit), nodes[child].hash);
+			i = j;
+		}
+	}
+
+	nodes[index].hash = hash;
+
+	return index;
+}
+
+static std::vector<struct merkle_node> build_tree(const std::vector<struct merkle_leaf> &leaves) {
+	std::vector<struct merkle_node> nodes;
+
+	build_node(leaves, 0, leaves.size(), 0, nodes);
+
+	return nodes;
+}
+
+static bool is_leaf_node(const struct merkle_node &node) {
+	return std::all_of(node.children.begin(), node.children.end(), [](const int child) { return child < 0; });
+}
+
+/*
+ * Compare the leaves of two ranges one by one.
+ */
+static void diff_leaves(const std::vector<struct merkle_leaf> &a, size_t a_begin, const size_t a_end,
+						const std::vector<struct merkle_leaf> &b, size_t b_begin, const size_t b_end,
+						std::vector<uint64_t> &keys) {
+	while(a_begin < a_end or b_begin < b_end) {
+		if(b_begin == b_end or (a_begin < a_end and a[a_begin].key < b[b_begin].key)) {
+			keys.push_back(a[a_begin++].key);
+		} else if(a_begin == a_end or b[b_begin].key < a[a_begin].key) {
+			keys.push_back(b[b_begin++].key);
+		} else {
+			if(a[a_begin].hash not_eq b[b_begin].hash)
+				keys.push_back(a[a_begin].key);
+			++a_begin;
+			++b_begin;
+		}
+	}
+}
+
+static void diff_nodes(const std::vector<struct merkle_leaf> &a, const std::vector<struct merkle_node> &a_nodes, const int a_index,
+					   const std::vector<struct merkle_leaf> &b, const std::vector<struct merkle_node> &b_nodes, const int b_index,
+					   size_t &compared, std::vector<uint64_t> &keys) {
+	if(a_index < 0 and b_index < 0)
+		return;
+	if(a_index < 0) {
+		diff_leaves(a, 0, 0, b, b_nodes[b_index].begin, b_nodes[b_index].end, keys);
+		return;
+	}
+	if(b_index < 0) {
+		diff_leaves(a, a_nodes[a_index].begin, a_nodes[a_index].end, b, 0, 0, keys);
+		return;
+	}
+
+	const struct merkle_node &a_node = a_nodes[a_index], &b_node = b_nodes[b_index];
+
+	++compared;
+	if(a_node.hash == b_node.hash)
+		return;
+
+	// one side is small enough to compare directly
+	if(is_leaf_node(a_node) or is_leaf_node(b_node)) {
+		diff_leaves(a, a_node.begin, a_node.end, b, b_node.begin, b_node.end, keys);
+		return;
+	}
+
+	for(int digit = 0; digit < MERKLE_FANOUT; ++digit) {
+		diff_nodes(a, a_nodes, a_node.children[digit], b, b_nodes, b_node.children[digit], compared, keys);
+	}
+}
+
+std::vector<uint64_t> merkle_diff(const std::vector<struct merkle_leaf> &a,
+								  const std::vector<struct merkle_leaf> &b,
+								  size_t &compared) {
+	const std::vector<struct merkle_node> a_nodes = build_tree(a), b_nodes = build_tree(b);
+	std::vector<uint64_t> keys;
+
+	compared = 0;
+	diff_nodes(a, a_nodes, 0, b, b_nodes, 0, compared, keys);
+
+	return keys;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief 64-bit hash of a string (FNV-1a with a final mix), the same on every
+ * platform so that hashes stored by different databases can be compared.
+ */
+uint64_t hash_string(const std::string_view str);
+
+struct merkle_leaf {
+	uint64_t key;
+	uint64_t hash;
+};
+
+/**
+ * @brief Find the keys at which two sets of leaves differ, i.e. those found
+ * in only one of them or with a different hash in each.
+ *
+ * Each set is rolled up into a tree over ranges of the key space, each node
+ * splitting its range in MERKLE_FANOUT, with the hash of a node made of those
+ * of its children. Trees are compared from the root, only going down into
+ * ranges whose hashes differ, so few differences cost O(log N) comparisons.
+ *
+ * @param a Leaves sorted by key, with unique keys.
+ * @param b Leaves sorted by key, with unique keys.
+ * @param compared Number of node hashes compared.
+ *
+ * @return The differing keys, sorted.
+ */
+std::vector<uint64_t> merkle_diff(const std::vector<struct merkle_leaf> &a,
+								  const std::vector<struct merkle_leaf> &b,
+								  size_t &compared);
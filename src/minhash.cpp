@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "minhash.hpp"
+
+#include <cstddef>
+#include <limits>
+
+/*
+ * splitmix64 finalizer; a cheap, well-mixed 64-bit hash used both to derive
+ * the MINHASH_SZ hash functions and to hash bands into buckets.
+ */
+static inline uint64_t mix64(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+minhash_sig minhash_signature(const std::vector<int> &ids) {
+	minhash_sig sig(MINHASH_SZ, std::numeric_limits<uint32_t>::max());
+
+	for(auto id : ids) {
+		const uint64_t base = mix64(static_cast<uint64_t>(id));
+
+		for(int i = 0; i < MINHASH_SZ; ++i) {
+			const uint32_t h = static_cast<uint32_t>(mix64(base + i));
+			if(h < sig[i])
+				sig[i] = h;
+		}
+	}
+
+	return sig;
+}
+
+int64_t lsh_bucket(const minhash_sig &sig, const int band) {
+	uint64_t h = static_cast<uint64_t>(band);
+
+	for(int i = band * LSH_ROWS; i < (band + 1) * LSH_ROWS; ++i)
+		h = mix64(h ^ sig[i]);
+
+	return static_cast<int64_t>(h);
+}
+
+double jaccard(const std::vector<int> &a, const std::vector<int> &b) {
+	size_t common = 0;
+
+	if(a.empty() and b.empty())
+		return 0;
+
+	for(auto i = a.begin(), j = b.begin(); i not_eq a.end() and j not_eq b.end();) {
+		if(*i < *j) {
+			++i;
+		} else if(*j < *i) {
+			++j;
+		} else {
+			++common;
+			++i;
+			++j;
+		}
+	}
+
+	return static_cast<double>(common) / static_cast<double>(a.size() + b.size() - common);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * A signature is made of MINHASH_SZ minimum hashes, split into LSH_BANDS bands
+ * of MINHASH_SZ / LSH_BANDS rows each. Two sets share at least one band
+ * bucket with probability 1-(1-s^r)^b for Jaccard similarity s, which puts the
+ * threshold at roughly 50% similarity.
+ */
+#define MINHASH_SZ 64
+#define LSH_BANDS 16
+#define LSH_ROWS (MINHASH_SZ / LSH_BANDS)
+
+typedef std::vector<uint32_t> minhash_sig;
+
+/**
+ * @brief Compute the MinHash signature of a set of IDs.
+ *
+ * @param ids Members of the set (order and duplicates do not matter).
+ *
+ * @return Signature of MINHASH_SZ values; all UINT32_MAX for the empty set.
+ */
+minhash_sig minhash_signature(const std::vector<int> &ids);
+
+/**
+ * @brief Hash the rows of a band of a signature into an LSH bucket.
+ *
+ * @param sig Signature, as returned by minhash_signature().
+ * @param band Index of the band, between 0 and LSH_BANDS-1.
+ */
+int64_t lsh_bucket(const minhash_sig &sig, const int band);
+
+/**
+ * @brief Exact Jaccard similarity of two sorted sets of IDs.
+ */
+double jaccard(const std::vector<int> &a, const std::vector<int> &b);
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "nutrition.hpp"
+
+const struct nutrient_info nutrients[NUTRIENT_NUM] = {
+	{ "kcal", "kcal" },
+	{ "protein", "g" },
+	{ "fat", "g" },
+	{ "saturated-fat", "g" },
+	{ "monounsaturated-fat", "g" },
+	{ "polyunsaturated-fat", "g" },
+	{ "trans-fat", "g" },
+	{ "cholesterol", "mg" },
+	{ "carbs", "g" },
+	{ "sugar", "g" },
+	{ "fibre", "g" },
+	{ "sodium", "mg" },
+	{ "potassium", "mg" },
+	{ "calcium", "mg" },
+	{ "iron", "mg" },
+	{ "magnesium", "mg" },
+	{ "phosphorus", "mg" },
+	{ "zinc", "mg" },
+	{ "vitamin-a", "ug" },
+	{ "vitamin-c", "mg" },
+	{ "vitamin-d", "ug" },
+	{ "vitamin-e", "mg" },
+	{ "vitamin-k", "ug" },
+	{ "thiamin", "mg" },
+	{ "riboflavin", "mg" },
+	{ "niacin", "mg" },
+	{ "vitamin-b6", "mg" },
+	{ "folate", "ug" },
+	{ "vitamin-b12", "ug" },
+	{ "alcohol", "g" },
+};
+
+int nutrient_index(const std::string &name) {
+	for(int i = 0; i < NUTRIENT_NUM; ++i) {
+		if(name == nutrients[i].name)
+			return i;
+	}
+
+	return -1;
+}
+
+void nutrient_add_scaled(float *__restrict dst, const float *__restrict src, const float factor) {
+	// fixed trip count with no aliasing, which the compiler turns into SIMD
+	for(int i = 0; i < NUTRIENT_VEC_SZ; ++i)
+		dst[i] += factor * src[i];
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <string>
+
+#define NUTRIENT_NUM 30
+// nutrient vectors are padded so that they fill whole SIMD registers
+#define NUTRIENT_VEC_SZ 32
+
+struct nutrient_info {
+	const char *name;
+	const char *unit;
+};
+
+extern const struct nutrient_info nutrients[NUTRIENT_NUM];
+
+typedef std::array<float, NUTRIENT_VEC_SZ> nutrient_vec;
+
+/**
+ * @brief Find a nutrient by name.
+ *
+ * @return Index of the nutrient in nutrients, or -1 if there is none.
+ */
+int nutrient_index(const std::string &name);
+
+/**
+ * @brief Add src scaled by factor to dst, i.e. dst += factor * src, over
+ * NUTRIENT_VEC_SZ values.
+ */
+void nutrient_add_scaled(float *__restrict dst, const float *__restrict src, const float factor);
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "prefix_index.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string prefix_index_key(const std::string &name) {
+	std::string key = name;
+
+	trim(key);
+	std::transform(key.begin(), key.end(), key.begin(),
+				   [](unsigned char c) { return std::tolower(c); });
+	// keys and values are separated by tabs and newlines
+	std::replace_if(key.begin(), key.end(), [](char c) { return c == '\t' or c == '\n'; }, ' ');
+
+	return key;
+}
+
+bool write_prefix_index(const std::string &path, std::vector<std::pair<std::string, std::string>> entries) {
+	// unique to this process, so that concurrent rebuilds never write the same file
+	std::string tmp_path = path + ".XXXXXX";
+	std::ostringstream contents;
+	int fd;
+
+	std::sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+	for(const auto &entry : entries) {
+		std::string value = entry.second;
+
+		std::replace_if(value.begin(), value.end(), [](char c) { return c == '\n'; }, ' ');
+		contents << entry.first << '\t' << value << '\n';
+	}
+
+	if((fd = mkstemp(tmp_path.data())) == -1)
+		return false;
+
+	const std::string data = contents.str();
+	for(size_t written = 0; written < data.size();) {
+		const ssize_t n = write(fd, data.data() + written, data.size() - written);
+		if(n == -1 and errno == EINTR)
+			continue;
+		if(n == -1) {
+			::close(fd);
+			unlink(tmp_path.c_str());
+			return false;
+		}
+		written += n;
+	}
+
+	if(::close(fd) == -1 or std::rename(tmp_path.c_str(), path.c_str()) not_eq 0) {
+		unlink(tmp_path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Start of the line containing position pos.
+ */
+static inline size_t line_start(const char *data, size_t pos) {
+	while(pos > 0 and data[pos - 1] not_eq '\n')
+		--pos;
+	return pos;
+}
+
+bool lookup_prefix_index(const std::string &path, std::string prefix, std::vector<std::string> &values) {
+	struct stat st;
+	const char *data;
+	size_t lo = 0, hi;
+	int fd;
+
+	if((fd = ::open(path.c_str(), O_RDONLY)) == -1)
+		return false;
+
+	if(fstat(fd, &st) == -1) {
+		::close(fd);
+		return false;
+	}
+
+	if(st.st_size == 0) {
+		::close(fd);
+		return true;
+	}
+
+	data = static_cast<const char*>(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+	::close(fd);
+	if(data == MAP_FAILED)
+		return false;
+
+	prefix = prefix_index_key(prefix);
+	hi = st.st_size;
+
+	// find the first line whose key is not less than the prefix
+	while(lo < hi) {
+		const size_t mid = line_start(data, lo + (hi - lo) / 2);
+		const char *tab = static_cast<const char*>(std::memchr(data + mid, '\t', st.st_size - mid));
+		const char *eol = static_cast<const char*>(std::memchr(data + mid, '\n', st.st_size - mid));
+		const std::string_view key(data + mid, (tab ? tab : data + st.st_size) - (data + mid));
+
+		if(key < prefix)
+			lo = eol ? eol - data + 1 : st.st_size;
+		else
+			hi = mid;
+	}
+
+	while(lo < static_cast<size_t>(st.st_size)) {
+		const char *tab = static_cast<const char*>(std::memchr(data + lo, '\t', st.st_size - lo));
+		const char *eol = static_cast<const char*>(std::memchr(data + lo, '\n', st.st_size - lo));
+
+		if(not tab or not eol or tab > eol)
+			break;
+		if(std::string_view(data + lo, tab - (data + lo)).substr(0, prefix.size()) not_eq prefix)
+			break;
+
+		values.emplace_back(tab + 1, eol);
+		lo = eol - data + 1;
+	}
+
+	munmap(const_cast<char*>(data), st.st_size);
+
+	return true;
+}
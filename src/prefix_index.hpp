@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * A prefix index is a text file of "<key>\t<value>" lines sorted by key, where
+ * the key is the lower-cased value. Lookups memory-map the file and binary
+ * search it, so they need neither SQLite nor reading the whole file.
+ */
+
+/**
+ * @brief Write a prefix index, atomically replacing any previous one.
+ *
+ * @param path Path of the index file.
+ * @param entries Pairs of key and value (in any order).
+ *
+ * @return false if the index could not be written.
+ */
+bool write_prefix_index(const std::string &path, std::vector<std::pair<std::string, std::string>> entries);
+
+/**
+ * @brief Find the values whose key starts with a prefix.
+ *
+ * @param path Path of the index file.
+ * @param prefix Prefix to look for (it is lower-cased like the keys).
+ * @param values Where the values found are appended.
+ *
+ * @return false if the index could not be read.
+ */
+bool lookup_prefix_index(const std::string &path, std::string prefix, std::vector<std::string> &values);
+
+/**
+ * @brief Normalize a name into an index key.
+ */
+std::string prefix_index_key(const std::string &name);
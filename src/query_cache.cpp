@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "query_cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+void query_cache::load(const std::string &path) {
+	std::ifstream file(path);
+	std::string line;
+
+	loaded = true;
+	if(not file.is_open() or not (file >> stamp >> total_hits >> total_misses >> tick))
+		return;
+	std::getline(file, line);
+
+	while(std::getline(file, line)) {
+		std::istringstream fields(line);
+		struct entry entry;
+		std::string key;
+		int id;
+
+		if(not (fields >> entry.last_used) or fields.get() not_eq '\t' or
+		   not std::getline(fields, key, '\t')) {
+			// an entry cut short is as good as a missing one
+			continue;
+		}
+		while(fields >> id)
+			entry.ids.push_back(id);
+		entries[key] = std::move(entry);
+	}
+}
+
+bool query_cache::save(const std::string &path) {
+	// unique to this process, so that concurrent saves never write the same file
+	std::string tmp_path = path + ".XXXXXX";
+	std::ostringstream contents;
+	int fd;
+
+	if(not dirty)
+		return true;
+
+	contents << stamp << ' ' << total_hits << ' ' << total_misses << ' ' << tick << '\n';
+	for(const auto &[key, entry] : entries) {
+		contents << entry.last_used << '\t' << key << '\t';
+		for(size_t i = 0; i < entry.ids.size(); ++i)
+			contents << (i ? " " : "") << entry.ids[i];
+		contents << '\n';
+	}
+
+	if((fd = mkstemp(tmp_path.data())) == -1)
+		return false;
+
+	const std::string data = contents.str();
+	for(size_t written = 0; written < data.size();) {
+		const ssize_t n = write(fd, data.data() + written, data.size() - written);
+		if(n == -1 and errno == EINTR)
+			continue;
+		if(n == -1) {
+			close(fd);
+			unlink(tmp_path.c_str());
+			return false;
+		}
+		written += n;
+	}
+
+	if(close(fd) == -1 or std::rename(tmp_path.c_str(), path.c_str()) not_eq 0) {
+		unlink(tmp_path.c_str());
+		return false;
+	}
+
+	dirty = false;
+
+	return true;
+}
+
+const std::vector<int> *query_cache::lookup(const std::string &key, const uint32_t stamp) {
+	if(stamp not_eq this->stamp) {
+		entries.clear();
+		this->stamp = stamp;
+		dirty = true;
+	}
+
+	auto entry = entries.find(key);
+	if(entry == entries.end()) {
+		++misses;
+		++total_misses;
+		return nullptr;
+	}
+
+	++hits;
+	++total_hits;
+	/*
+	 * Hits on recently used entries don't change what would be evicted, so
+	 * only rewrite the file for those that were getting close to it.
+	 */
+	if(tick - entry->second.last_used >= QUERY_CACHE_SZ / 2) {
+		entry->second.last_used = ++tick;
+		dirty = true;
+	}
+
+	return &entry->second.ids;
+}
+
+void query_cache::insert(const std::string &key, const std::vector<int> &ids) {
+	dirty = true;
+
+	if(entries.size() >= QUERY_CACHE_SZ and not entries.contains(key)) {
+		entries.erase(std::min_element(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+									   return a.second.last_used < b.second.last_used;
+									   }));
+	}
+
+	entries[key] = { ++tick, ids };
+}
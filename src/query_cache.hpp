@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024  Nicolás Ortega Froysa <nicolas@ortegas.org>
+ * Nicolás Ortega Froysa <nicolas@ortegas.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// number of queries whose results are kept
+#define QUERY_CACHE_SZ 64
+
+/*
+ * A query cache keeps the IDs of the recipes matched by recent filters in a
+ * text file shared by every invocation. Its first line holds the change
+ * counter of the database the results are valid for, the total number of hits
+ * and misses, and the last use tick. Each of the other lines holds an entry:
+ * "<last use>\t<key>\t<id> <id>...".
+ */
+class query_cache {
+private:
+	struct entry {
+		uint64_t last_used;
+		std::vector<int> ids;
+	};
+
+	std::map<std::string, struct entry> entries;
+	uint32_t stamp;
+	uint64_t tick;
+	bool loaded, dirty;
+
+public:
+	/*
+	 * Over every invocation sharing the file. These are only written along
+	 * with changes to the entries, so they may miss some hits.
+	 */
+	uint64_t total_hits, total_misses;
+	// since the cache was loaded
+	uint64_t hits, misses;
+
+	query_cache() : stamp(0), tick(0), loaded(false), dirty(false),
+		total_hits(0), total_misses(0), hits(0), misses(0) {}
+
+	/**
+	 * @brief Read the cache from a file, starting empty if there's none (or
+	 * it can't be read).
+	 */
+	void load(const std::string &path);
+	/**
+	 * @brief Write the cache, atomically replacing the file, if its entries
+	 * changed since it was loaded (the counters alone don't count).
+	 *
+	 * @return false if the cache could not be written.
+	 */
+	bool save(const std::string &path);
+	bool is_loaded(void) const { return loaded; }
+
+	/**
+	 * @brief Find the recipes matched by a query, counting a hit or a miss.
+	 *
+	 * @param key Normalized filters of the query.
+	 * @param stamp Change counter of the database. All entries are dropped
+	 * if it changed since they were stored.
+	 *
+	 * @return The IDs of the recipes, or nullptr if the query isn't cached.
+	 */
+	const std::vector<int> *lookup(const std::string &key, const uint32_t stamp);
+	/**
+	 * @brief Store the recipes matched by a query, evicting the least
+	 * recently used entry if the cache is full.
+	 */
+	void insert(const std::string &key, const std::vector<int> &ids);
+};
@@ -18,28 +18,98 @@
 #include "util.hpp"
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
 
-std::vector<std::string> split(std::string str, const std::string &delim) {
-	std::vector<std::string> result;
-	std::string substr;
-	size_t pos = 0;
+std::vector<std::string_view> split_view(std::string_view str, const std::string_view delim) {
+	std::vector<std::string_view> result;
+	size_t pos;
 
-	while((pos = str.find(delim)) not_eq std::string::npos) {
-		substr = str.substr(0, pos);
-		result.push_back(substr);
-		str.erase(0, pos + delim.size());
+	while((pos = str.find(delim)) not_eq std::string_view::npos) {
+		result.push_back(str.substr(0, pos));
+		str.remove_prefix(pos + delim.size());
 	}
 	result.push_back(str);
 
 	return result;
 }
 
+std::vector<std::string> split(const std::string_view str, const std::string_view delim) {
+	const std::vector<std::string_view> views = split_view(str, delim);
+
+	return std::vector<std::string>(views.begin(), views.end());
+}
+
+std::string_view trim_view(std::string_view str) {
+	while(not str.empty() and std::isspace(static_cast<unsigned char>(str.front())))
+		str.remove_prefix(1);
+	while(not str.empty() and std::isspace(static_cast<unsigned char>(str.back())))
+		str.remove_suffix(1);
+
+	return str;
+}
+
 void trim(std::string &str) {
-	str.erase(str.begin(),
-			  std::find_if(str.begin(), str.end(), [](char c) {
-								 return not std::isspace(c);
-								 }));
-	str.erase(std::find_if(str.rbegin(), str.rend(), [](char c) {
-						   return not std::isspace(c);
-						   }).base(), str.end());
+	const std::string_view trimmed = trim_view(str);
+
+	str.erase(trimmed.data() + trimmed.size() - str.data());
+	str.erase(0, trimmed.data() - str.data());
+}
+
+std::vector<std::string> split_list(const std::string_view str) {
+	std::vector<std::string> result;
+	const std::vector<std::string_view> views = split_view(str, ",");
+
+	result.reserve(views.size());
+	for(const auto &view : views)
+		result.emplace_back(trim_view(view));
+
+	return result;
+}
+
+/*
+ * Parse a number or fraction followed by whitespace, returning the number of
+ * characters it takes (0 if there is none).
+ */
+static size_t parse_number(const char *str, double &number) {
+	char *end;
+
+	if(not std::isdigit(static_cast<unsigned char>(*str)))
+		return 0;
+
+	number = std::strtod(str, &end);
+	if(*end == '/' and std::isdigit(static_cast<unsigned char>(end[1]))) {
+		const double denom = std::strtod(end + 1, &end);
+		if(denom == 0)
+			return 0;
+		number /= denom;
+	}
+
+	if(not std::isspace(static_cast<unsigned char>(*end)))
+		return 0;
+
+	return end - str;
+}
+
+bool parse_quantity(std::string &str, double &quantity) {
+	size_t len, frac_len;
+	double fraction;
+
+	if((len = parse_number(str.c_str(), quantity)) == 0)
+		return false;
+
+	while(std::isspace(static_cast<unsigned char>(str[len])))
+		++len;
+
+	// mixed numbers, e.g. "1 1/2"
+	if((frac_len = parse_number(str.c_str() + len, fraction)) > 0 and
+	   str.find('/', len) < len + frac_len) {
+		quantity += fraction;
+		len += frac_len;
+		while(std::isspace(static_cast<unsigned char>(str[len])))
+			++len;
+	}
+
+	str.erase(0, len);
+
+	return true;
 }
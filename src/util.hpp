@@ -19,6 +19,34 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
-std::vector<std::string> split(std::string str, const std::string &delim);
+std::vector<std::string> split(std::string_view str, const std::string_view delim);
 void trim(std::string &str);
+
+/**
+ * @brief Split a string by a delimiter without copying it.
+ *
+ * @return Views of the pieces, valid as long as the string is.
+ */
+std::vector<std::string_view> split_view(std::string_view str, const std::string_view delim);
+/**
+ * @brief View of a string without its leading and trailing whitespace.
+ */
+std::string_view trim_view(std::string_view str);
+/**
+ * @brief Split a comma-separated list (e.g. "garlic, tomato") into its
+ * trimmed elements.
+ */
+std::vector<std::string> split_list(const std::string_view str);
+
+/**
+ * @brief Take a leading quantity, such as "2", "1.5", "1/2" or "1 1/2", off
+ * the start of a string, along with the whitespace that follows it.
+ *
+ * @param str String to parse, which is left with whatever follows the quantity.
+ * @param quantity Parsed quantity.
+ *
+ * @return false (leaving str untouched) if str does not start with a quantity.
+ */
+bool parse_quantity(std::string &str, double &quantity);